@@ -0,0 +1,88 @@
+#ifndef SQLITEARRAY_H
+#define SQLITEARRAY_H
+
+#include <string>
+#include <string_view>
+#include <span>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_vtab;
+struct sqlite3_vtab_cursor;
+struct sqlite3_index_info;
+struct sqlite3_context;
+struct sqlite3_value;
+
+/**
+ * Array bound by SqliteCommand::addParameterArray() and read by table-valued function yasw_array:
+ *		select * from students where id in yasw_array(?)
+ * yasw_array is an eponymous virtual table registered by SqliteDb for every connection.
+ * It is named apart from the carray extension, so both can be loaded into the same connection.
+ * It has column value with array elements and hidden column pointer which receives the bound array.
+ * Elements are copied on binding, so the array may be destroyed before the statement is executed.
+ */
+class SqliteArray
+{
+	friend class SqliteCommand;
+	friend class SqliteDb;
+
+private:
+	explicit SqliteArray(std::span<const long long> values);
+	explicit SqliteArray(std::span<const long> values);
+	explicit SqliteArray(std::span<const int> values);
+	explicit SqliteArray(std::span<const double> values);
+	explicit SqliteArray(std::span<const std::string> values);
+	explicit SqliteArray(std::span<const std::string_view> values);
+
+	SqliteArray(const SqliteArray&) = delete;
+	SqliteArray(SqliteArray&&) = delete;
+	SqliteArray& operator=(const SqliteArray&) = delete;
+	SqliteArray& operator=(SqliteArray&&) = delete;
+
+	enum class ElementType
+	{
+		Int64,
+		Double,
+		Text
+	};
+
+	ElementType m_type;
+	size_t m_size;
+
+	std::vector<long long> m_int64Values;
+	std::vector<double> m_doubleValues;
+
+	// Texts stored one after another; text i is [m_textOffsets[i], m_textOffsets[i + 1])
+	std::string m_textArena;
+	std::vector<size_t> m_textOffsets;
+
+	inline static const char* const MODULE_NAME{ "yasw_array" };
+
+	// Type of pointer passed by sqlite3_bind_pointer
+	inline static const char* const POINTER_TYPE{ "yasw_array" };
+
+	template <class TText>
+	void assignTexts(std::span<const TText> values);
+
+	// Registers yasw_array module with the connection
+	static void registerModule(sqlite3* db);
+
+	// Destructor passed to sqlite3_bind_pointer
+	static void destroy(void* array);
+
+	struct Cursor;
+
+	// Virtual table methods
+	static int connect(sqlite3* db, void* aux, int argc, const char* const* argv, sqlite3_vtab** ppVtab, char** pzErr);
+	static int disconnect(sqlite3_vtab* pVtab);
+	static int bestIndex(sqlite3_vtab* pVtab, sqlite3_index_info* pIndexInfo);
+	static int open(sqlite3_vtab* pVtab, sqlite3_vtab_cursor** ppCursor);
+	static int close(sqlite3_vtab_cursor* pCursor);
+	static int filter(sqlite3_vtab_cursor* pCursor, int idxNum, const char* idxStr, int argc, sqlite3_value** argv);
+	static int next(sqlite3_vtab_cursor* pCursor);
+	static int eof(sqlite3_vtab_cursor* pCursor);
+	static int column(sqlite3_vtab_cursor* pCursor, sqlite3_context* context, int index);
+	static int rowid(sqlite3_vtab_cursor* pCursor, long long* pRowid);
+};
+
+#endif // SQLITEARRAY_H
@@ -0,0 +1,567 @@
+#ifndef SQLITEASYNCDB_H
+#define SQLITEASYNCDB_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <tuple>
+#include <span>
+#include <memory>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <functional>
+#include <optional>
+#include <variant>
+#include <exception>
+#include <coroutine>
+#include <cassert>
+#include <type_traits>
+#include "SqliteDb.h"
+
+class SqliteAsyncDb;
+
+/**
+ * Awaitable result of SqliteAsyncDb::submitAsync(), executeAsync() and selectAsync().
+ * Job is queued when the coroutine is suspended; the coroutine is resumed
+ * by the executor of SqliteAsyncDb after the job is done.
+ * Must be awaited once.
+ */
+template <class TResult>
+class SqliteAwaitable
+{
+	friend class SqliteAsyncDb;
+
+	template <class... TColumns>
+	friend class SqliteRowStream;
+
+public:
+	bool await_ready() const noexcept
+	{
+		return false;
+	}
+
+	void await_suspend(std::coroutine_handle<> handle);
+
+	// Returns result of the job or rethrows its exception
+	TResult await_resume();
+
+private:
+	SqliteAwaitable(SqliteAsyncDb* db, std::function<TResult(SqliteDb&)> func)
+		: m_db(db),
+		  m_func(std::move(func))
+	{
+	}
+
+	SqliteAwaitable(const SqliteAwaitable&) = delete;
+	SqliteAwaitable& operator=(const SqliteAwaitable&) = delete;
+
+	SqliteAsyncDb* m_db;
+	std::function<TResult(SqliteDb&)> m_func;
+
+	std::conditional_t<std::is_void_v<TResult>, std::monostate, std::optional<TResult>> m_result;
+	std::exception_ptr m_error;
+};
+
+/**
+ * Rows of a query read in batches by the worker thread of SqliteAsyncDb:
+ *		auto products = db.streamAsync<long long, std::string>("select id, name from products", 256);
+ *
+ *		for (auto rows = co_await products.next(); !rows.empty(); rows = co_await products.next())
+ *			for (const auto& [id, name] : rows)
+ *				// ...
+ *
+ * The statement is stepped only while a batch is requested and is released after the last row
+ * or when the stream is destroyed. Only one next() may be in progress at a time.
+ * Object lifetime cannot exceed lifetime of SqliteAsyncDb instance that was used to create the former.
+ */
+template <class... TColumns>
+class SqliteRowStream
+{
+	friend class SqliteAsyncDb;
+
+public:
+	typedef std::tuple<TColumns...> TRow;
+
+	~SqliteRowStream();
+
+	// Returns the next batch of rows; empty batch if all rows have been read
+	SqliteAwaitable<std::vector<TRow>> next();
+
+private:
+	typedef std::function<SqliteQuery<TColumns...>*(SqliteDb& db)> TOpenQuery;
+
+	SqliteRowStream(SqliteAsyncDb* db, TOpenQuery openQuery, size_t batchSize);
+
+	SqliteRowStream(const SqliteRowStream&) = delete;
+	SqliteRowStream(SqliteRowStream&&) = delete;
+	SqliteRowStream& operator=(const SqliteRowStream&) = delete;
+	SqliteRowStream& operator=(SqliteRowStream&&) = delete;
+
+	// Accessed on the worker thread only
+	struct State
+	{
+		TOpenQuery openQuery;
+		std::unique_ptr<SqliteQuery<TColumns...>> query;
+		typename SqliteQuery<TColumns...>::Iterator iterator;
+		bool finished = false;
+	};
+
+	SqliteAsyncDb* m_db;
+	std::shared_ptr<State> m_state;
+	const size_t m_batchSize;
+
+	static std::vector<TRow> fetch(State& state, SqliteDb& db, size_t batchSize);
+};
+
+/**
+ * Connection owned by a dedicated worker thread.
+ * Functions are thread safe and return immediately; jobs are executed in submission order
+ * and their results are delivered through futures.
+ * Jobs are passed to the worker through a lock-free multi-producer single-consumer queue.
+ * Usage:
+ *		SqliteAsyncDb db(L"/tmp/test.db");
+ *
+ *		auto done = db.execute("insert into students (name) values (?)", "Bob");
+ *		auto rows = db.select<long long, std::string>("select id, name from students");
+ *
+ *		for (const auto& [id, name] : rows.get())
+ *			// ...
+ *
+ * Rows are copied into std::tuple<TColumns...>, so views are not allowed as column types.
+ * Pending jobs are executed on destruction.
+ *
+ * Coroutines can await jobs instead of blocking on futures:
+ *		size_t count = co_await db.submitAsync([](SqliteDb& db) { ... });
+ *		co_await db.executeAsync("delete from students where id = ?", id);
+ *		auto rows = co_await db.selectAsync<long long, std::string>("select id, name from students");
+ * Awaiting coroutine is resumed by the executor set with setExecutor(),
+ * or on the worker thread if there is no executor; it must not block the worker then.
+ */
+class SqliteAsyncDb
+{
+	template <class TResult>
+	friend class SqliteAwaitable;
+
+	template <class... TColumns>
+	friend class SqliteRowStream;
+
+public:
+	// Resumes coroutine, e.g. by posting it to a thread pool
+	typedef std::function<void(std::coroutine_handle<> handle)> TExecutor;
+	SqliteAsyncDb(const std::wstring& dbFileName, const SqliteDbOptions& options = SqliteDbOptions());
+	SqliteAsyncDb(std::string_view dbFileName, const SqliteDbOptions& options = SqliteDbOptions());
+	~SqliteAsyncDb();
+
+	// Runs func(SqliteDb&) on the worker thread. Future receives its result or exception
+	template <class TFunc>
+	std::future<std::invoke_result_t<std::decay_t<TFunc>&, SqliteDb&>> submit(TFunc&& func);
+
+	// Executes non-query SQL with parameters bound by SqliteCommand::addParameters()
+	template <class... TArgs>
+	std::future<void> execute(std::string_view sql, const TArgs&... args);
+
+	// Executes query and returns all its rows, see SqliteDb::query()
+	template <class... TColumns, class... TArgs>
+	std::future<std::vector<std::tuple<TColumns...>>> select(std::string_view sql, const TArgs&... args);
+
+	// Sets executor resuming awaiting coroutines. Not thread safe: call before awaiting any job
+	void setExecutor(TExecutor executor);
+
+	// Awaitable counterparts of submit(), execute() and select()
+	template <class TFunc>
+	SqliteAwaitable<std::invoke_result_t<std::decay_t<TFunc>&, SqliteDb&>> submitAsync(TFunc&& func);
+
+	template <class... TArgs>
+	SqliteAwaitable<void> executeAsync(std::string_view sql, const TArgs&... args);
+
+	template <class... TColumns, class... TArgs>
+	SqliteAwaitable<std::vector<std::tuple<TColumns...>>> selectAsync(std::string_view sql, const TArgs&... args);
+
+	// Returns stream of query rows read in batches of batchSize rows
+	template <class... TColumns, class... TArgs>
+	SqliteRowStream<TColumns...> streamAsync(std::string_view sql, size_t batchSize, const TArgs&... args);
+
+private:
+	SqliteAsyncDb(const SqliteAsyncDb&) = delete;
+	SqliteAsyncDb(SqliteAsyncDb&&) = delete;
+	SqliteAsyncDb& operator=(const SqliteAsyncDb&) = delete;
+	SqliteAsyncDb& operator=(SqliteAsyncDb&&) = delete;
+
+	// Node of the job queue
+	struct Job
+	{
+		std::atomic<Job*> next{ nullptr };
+
+		virtual ~Job() = default;
+		virtual void run(SqliteDb& db) = 0;
+	};
+
+	// Job which is never run: queue stub and stop marker
+	struct EmptyJob : Job
+	{
+		void run(SqliteDb&) override { }
+	};
+
+	template <class TFunc>
+	struct PostedJob : Job
+	{
+		explicit PostedJob(TFunc&& func)
+			: func(std::move(func))
+		{
+		}
+
+		void run(SqliteDb& db) override
+		{
+			func(db);
+		}
+
+		TFunc func;
+	};
+
+	template <class TFunc, class TResult>
+	struct TypedJob : Job
+	{
+		explicit TypedJob(TFunc&& func)
+			: func(std::move(func))
+		{
+		}
+
+		void run(SqliteDb& db) override;
+
+		TFunc func;
+		std::promise<TResult> promise;
+	};
+
+	// Parameter value copied into job: views are replaced with owning types, also inside std::optional
+	template <class T>
+	struct StoredArgument
+	{
+		typedef std::conditional_t<!std::is_null_pointer_v<T> && std::is_convertible_v<const T&, std::string_view>, std::string,
+			std::conditional_t<!std::is_null_pointer_v<T> && std::is_convertible_v<const T&, const wchar_t*>, std::wstring,
+			std::conditional_t<std::is_convertible_v<const T&, std::span<const std::byte>>, std::vector<std::byte>, T>>> TType;
+	};
+
+	template <class T>
+	struct StoredArgument<std::optional<T>>
+	{
+		typedef std::optional<typename StoredArgument<T>::TType> TType;
+	};
+
+	template <class T>
+	using TStoredArgument = typename StoredArgument<T>::TType;
+
+	template <class T>
+	static TStoredArgument<T> storeArgument(const T& value);
+
+	template <class T>
+	static constexpr bool isOwningColumn();
+
+	// Vyukov MPSC queue: producers exchange m_head, the worker consumes from m_tail
+	std::atomic<Job*> m_head;
+	Job* m_tail;
+	EmptyJob m_stub;
+
+	// Number of pushed jobs not consumed yet; the worker waits on it
+	std::atomic<unsigned int> m_pendingJobCount;
+
+	EmptyJob m_stopJob;
+
+	TExecutor m_executor;
+
+	std::thread m_thread;
+
+	// Queues func(SqliteDb&) without a result; func must not throw
+	template <class TFunc>
+	void post(TFunc&& func);
+
+	// Resumes coroutine with the executor
+	void resume(std::coroutine_handle<> handle);
+
+	// Returns function binding copies of args to the command
+	template <class... TArgs>
+	static auto bindArguments(const TArgs&... args);
+
+	// Starts the worker and waits until it opens the connection
+	void start(std::function<std::unique_ptr<SqliteDb>()> openDb);
+
+	void run(const std::function<std::unique_ptr<SqliteDb>()>& openDb, std::promise<void>& opened);
+
+	void push(Job* job);
+
+	// Returns nullptr if the queue is empty or a producer has not completed push() yet
+	Job* pop();
+};
+
+template <class TFunc, class TResult>
+void
+SqliteAsyncDb::TypedJob<TFunc, TResult>::run(SqliteDb& db)
+{
+	try
+	{
+		if constexpr (std::is_void_v<TResult>)
+		{
+			func(db);
+			promise.set_value();
+		}
+		else
+			promise.set_value(func(db));
+	}
+	catch (...)
+	{
+		promise.set_exception(std::current_exception());
+	}
+}
+
+template <class TFunc>
+std::future<std::invoke_result_t<std::decay_t<TFunc>&, SqliteDb&>>
+SqliteAsyncDb::submit(TFunc&& func)
+{
+	typedef std::decay_t<TFunc> TFunction;
+	typedef std::invoke_result_t<TFunction&, SqliteDb&> TResult;
+
+	auto job = new TypedJob<TFunction, TResult>(TFunction(std::forward<TFunc>(func)));
+	auto future = job->promise.get_future();
+
+	push(job);
+
+	return future;
+}
+
+template <class TFunc>
+void
+SqliteAsyncDb::post(TFunc&& func)
+{
+	typedef std::decay_t<TFunc> TFunction;
+
+	push(new PostedJob<TFunction>(TFunction(std::forward<TFunc>(func))));
+}
+
+template <class T>
+SqliteAsyncDb::TStoredArgument<T>
+SqliteAsyncDb::storeArgument(const T& value)
+{
+	if constexpr (SqliteRecordset::IsOptional<T>::value)
+	{
+		if (!value.has_value())
+			return std::nullopt;
+
+		return storeArgument(value.value());
+	}
+	else if constexpr (std::is_same_v<TStoredArgument<T>, std::vector<std::byte>>)
+	{
+		std::span<const std::byte> blob(value);
+		return std::vector<std::byte>(blob.begin(), blob.end());
+	}
+	else
+		return TStoredArgument<T>(value);
+}
+
+template <class... TArgs>
+auto
+SqliteAsyncDb::bindArguments(const TArgs&... args)
+{
+	// Views are copied since the command is executed later
+	return [args = std::tuple<TStoredArgument<TArgs>...>(storeArgument(args)...)](auto&& bind) {
+		return std::apply(bind, args);
+	};
+}
+
+template <class... TArgs>
+std::future<void>
+SqliteAsyncDb::execute(std::string_view sql, const TArgs&... args)
+{
+	return submit([sql = std::string(sql), bind = bindArguments(args...)](SqliteDb& db) {
+		bind([&db, &sql](const auto&... values) {
+			db.prepare(sql)
+				.addParameters(values...)
+				.execute();
+		});
+	});
+}
+
+template <class... TColumns, class... TArgs>
+std::future<std::vector<std::tuple<TColumns...>>>
+SqliteAsyncDb::select(std::string_view sql, const TArgs&... args)
+{
+	static_assert((isOwningColumn<TColumns>() && ...), "Views cannot be used as column types");
+
+	return submit([sql = std::string(sql), bind = bindArguments(args...)](SqliteDb& db) {
+		std::vector<std::tuple<TColumns...>> rows;
+
+		bind([&db, &sql, &rows](const auto&... values) {
+			for (auto&& row : db.query<TColumns...>(std::string_view(sql), values...))
+				rows.push_back(std::move(row));
+		});
+
+		return rows;
+	});
+}
+
+template <class TFunc>
+SqliteAwaitable<std::invoke_result_t<std::decay_t<TFunc>&, SqliteDb&>>
+SqliteAsyncDb::submitAsync(TFunc&& func)
+{
+	return SqliteAwaitable<std::invoke_result_t<std::decay_t<TFunc>&, SqliteDb&>>(this, std::forward<TFunc>(func));
+}
+
+template <class... TArgs>
+SqliteAwaitable<void>
+SqliteAsyncDb::executeAsync(std::string_view sql, const TArgs&... args)
+{
+	return SqliteAwaitable<void>(this, [sql = std::string(sql), bind = bindArguments(args...)](SqliteDb& db) {
+		bind([&db, &sql](const auto&... values) {
+			db.prepare(sql)
+				.addParameters(values...)
+				.execute();
+		});
+	});
+}
+
+template <class... TColumns, class... TArgs>
+SqliteAwaitable<std::vector<std::tuple<TColumns...>>>
+SqliteAsyncDb::selectAsync(std::string_view sql, const TArgs&... args)
+{
+	static_assert((isOwningColumn<TColumns>() && ...), "Views cannot be used as column types");
+
+	return SqliteAwaitable<std::vector<std::tuple<TColumns...>>>(this,
+		[sql = std::string(sql), bind = bindArguments(args...)](SqliteDb& db) {
+			std::vector<std::tuple<TColumns...>> rows;
+
+			bind([&db, &sql, &rows](const auto&... values) {
+				for (auto&& row : db.query<TColumns...>(std::string_view(sql), values...))
+					rows.push_back(std::move(row));
+			});
+
+			return rows;
+		});
+}
+
+template <class... TColumns, class... TArgs>
+SqliteRowStream<TColumns...>
+SqliteAsyncDb::streamAsync(std::string_view sql, size_t batchSize, const TArgs&... args)
+{
+	static_assert((isOwningColumn<TColumns>() && ...), "Views cannot be used as column types");
+
+	return SqliteRowStream<TColumns...>(this,
+		[sql = std::string(sql), bind = bindArguments(args...)](SqliteDb& db) {
+			return bind([&db, &sql](const auto&... values) {
+				// Query is constructed in place from the returned prvalue
+				return new SqliteQuery<TColumns...>(db.query<TColumns...>(std::string_view(sql), values...));
+			});
+		}, batchSize);
+}
+
+template <class TResult>
+void
+SqliteAwaitable<TResult>::await_suspend(std::coroutine_handle<> handle)
+{
+	m_db->post([this, handle](SqliteDb& db) {
+		try
+		{
+			if constexpr (std::is_void_v<TResult>)
+				m_func(db);
+			else
+				m_result.emplace(m_func(db));
+		}
+		catch (...)
+		{
+			m_error = std::current_exception();
+		}
+
+		// This instance may be destroyed once the coroutine is resumed
+		m_db->resume(handle);
+	});
+}
+
+template <class TResult>
+TResult
+SqliteAwaitable<TResult>::await_resume()
+{
+	if (m_error)
+		std::rethrow_exception(m_error);
+
+	if constexpr (!std::is_void_v<TResult>)
+		return std::move(m_result.value());
+}
+
+template <class... TColumns>
+SqliteRowStream<TColumns...>::SqliteRowStream(SqliteAsyncDb* db, TOpenQuery openQuery, size_t batchSize)
+	: m_db(db),
+	  m_state(std::make_shared<State>()),
+	  m_batchSize(batchSize)
+{
+	assert(m_batchSize > 0);
+
+	m_state->openQuery = std::move(openQuery);
+}
+
+template <class... TColumns>
+SqliteRowStream<TColumns...>::~SqliteRowStream()
+{
+	// Statement has to be released on the worker thread
+	m_db->post([state = m_state](SqliteDb&) {
+		state->query.reset();
+	});
+}
+
+template <class... TColumns>
+SqliteAwaitable<std::vector<typename SqliteRowStream<TColumns...>::TRow>>
+SqliteRowStream<TColumns...>::next()
+{
+	return SqliteAwaitable<std::vector<TRow>>(m_db, [state = m_state, batchSize = m_batchSize](SqliteDb& db) {
+		return fetch(*state, db, batchSize);
+	});
+}
+
+template <class... TColumns>
+std::vector<typename SqliteRowStream<TColumns...>::TRow>
+SqliteRowStream<TColumns...>::fetch(State& state, SqliteDb& db, size_t batchSize)
+{
+	std::vector<TRow> rows;
+	if (state.finished)
+		return rows;
+
+	try
+	{
+		if (!state.query)
+		{
+			state.query.reset(state.openQuery(db));
+			state.iterator = state.query->begin();
+		}
+
+		rows.reserve(batchSize);
+		while (rows.size() < batchSize && !(state.iterator == std::default_sentinel))
+		{
+			rows.push_back(*state.iterator);
+			++state.iterator;
+		}
+
+		if (state.iterator == std::default_sentinel)
+		{
+			state.query.reset();
+			state.finished = true;
+		}
+	}
+	catch (...)
+	{
+		state.query.reset();
+		state.finished = true;
+
+		throw;
+	}
+
+	return rows;
+}
+
+template <class T>
+constexpr bool
+SqliteAsyncDb::isOwningColumn()
+{
+	if constexpr (SqliteRecordset::IsOptional<T>::value)
+		return isOwningColumn<typename T::value_type>();
+	else
+		return !std::is_same_v<T, std::string_view> && !std::is_same_v<T, std::span<const std::byte>>;
+}
+
+#endif // SQLITEASYNCDB_H
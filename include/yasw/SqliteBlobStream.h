@@ -0,0 +1,60 @@
+#ifndef SQLITEBLOBSTREAM_H
+#define SQLITEBLOBSTREAM_H
+
+#include <span>
+#include <cstddef>
+
+struct sqlite3;
+struct sqlite3_blob;
+
+/**
+ * Incremental access to a blob stored in a table via sqlite3_blob_open.
+ * Use SqliteDb::openBlob() to create instance of SqliteBlobStream.
+ * Blob size cannot be changed; allocate space on insert with SqliteCommand::addParameterZeroBlob():
+ *		db.prepare("insert into documents (id, content) values (?, ?)")
+ *			.addParameter(id)
+ *			.addParameterZeroBlob(size)
+ *			.execute();
+ *
+ *		auto blob = db.openBlob("documents", "content", id, true);
+ *		for (size_t offset = 0; offset < size; offset += chunk.size())
+ *			blob.write(offset, chunk);
+ *
+ * Stream is expired if its row is modified by another statement; further reads and writes throw.
+ * Object lifetime cannot exceed lifetime of SqliteDb instance that was used to create the former.
+ */
+class SqliteBlobStream
+{
+	friend class SqliteDb;
+
+public:
+	~SqliteBlobStream();
+
+	// Size of the blob in bytes
+	size_t getSize() const;
+
+	// Reads buffer.size() bytes starting at offset. Throws if the range exceeds the blob size
+	void read(size_t offset, std::span<std::byte> buffer);
+
+	// Writes data starting at offset. Throws if the range exceeds the blob size or stream is read-only
+	void write(size_t offset, std::span<const std::byte> data);
+
+	// Moves stream to the same column of another row. Cheaper than opening a new stream
+	void reopen(long long rowid);
+
+private:
+	SqliteBlobStream(sqlite3* db, const char* szDatabase, const char* szTable, const char* szColumn, long long rowid, bool writable);
+
+	SqliteBlobStream(const SqliteBlobStream&) = delete;
+	SqliteBlobStream(SqliteBlobStream&&) = delete;
+	SqliteBlobStream& operator=(const SqliteBlobStream&) = delete;
+	SqliteBlobStream& operator=(SqliteBlobStream&&) = delete;
+
+	sqlite3* m_db;
+	sqlite3_blob* m_blob;
+
+	// Throws if offset + size exceeds the blob size
+	void checkRange(size_t offset, size_t size) const;
+};
+
+#endif // SQLITEBLOBSTREAM_H
@@ -0,0 +1,90 @@
+#ifndef SQLITEBUSYHANDLER_H
+#define SQLITEBUSYHANDLER_H
+
+#include <chrono>
+#include <atomic>
+#include <random>
+#include "SqliteBusyPolicy.h"
+
+struct sqlite3;
+
+/**
+ * Applies SqliteBusyPolicy to a connection with sqlite3_busy_handler
+ * and counts lock contention events.
+ * Used by SqliteDb; statistics can be read from any thread.
+ */
+class SqliteBusyHandler
+{
+public:
+	struct Stats
+	{
+		// Number of times a lock was found busy
+		unsigned long long busyCount = 0;
+
+		// Number of steps and transactions repeated from the start after SQLITE_BUSY
+		unsigned long long retryCount = 0;
+
+		// Number of SQLITE_BUSY results returned to a caller
+		unsigned long long failureCount = 0;
+
+		// Time spent waiting for locks
+		std::chrono::microseconds waitTime{ 0 };
+	};
+
+	SqliteBusyHandler();
+
+	const SqliteBusyPolicy& getPolicy() const;
+
+	// Installs busy handler to the connection, or removes it for Strategy::Fail
+	void setPolicy(sqlite3* db, const SqliteBusyPolicy& policy);
+
+	/**
+	 * Waits before retry of an operation that found a lock busy, started waiting at start.
+	 * attempt is the number of retries made so far. Returns false if operation has to fail.
+	 */
+	bool wait(int attempt, std::chrono::steady_clock::time_point start);
+
+	// Waits before retry of a transaction. Returns false if attempts are exhausted
+	bool wait(int attempt, const SqliteRetryPolicy& retryPolicy);
+
+	Stats getStats() const;
+
+	// Returns number of times a lock was found busy
+	unsigned long long getBusyCount() const;
+
+	void onBusy();
+	void onRetry();
+	void onFailure();
+
+private:
+	SqliteBusyHandler(const SqliteBusyHandler&) = delete;
+	SqliteBusyHandler(SqliteBusyHandler&&) = delete;
+	SqliteBusyHandler& operator=(const SqliteBusyHandler&) = delete;
+	SqliteBusyHandler& operator=(SqliteBusyHandler&&) = delete;
+
+	// Delays of Strategy::Timeout, same as used by sqlite3_busy_timeout
+	inline static const int TIMEOUT_DELAYS_MS[]{ 1, 2, 5, 10, 15, 20, 25, 25, 25, 50, 50, 100 };
+
+	SqliteBusyPolicy m_policy;
+
+	// Time when busy handler was called for the first time for the current lock
+	std::chrono::steady_clock::time_point m_busyStart;
+
+	std::minstd_rand m_random;
+
+	std::atomic<unsigned long long> m_busyCount;
+	std::atomic<unsigned long long> m_retryCount;
+	std::atomic<unsigned long long> m_failureCount;
+	std::atomic<long long> m_waitMicroseconds;
+
+	// Sleeps for delay unless it exceeds time left till timeout. Returns false if timeout expired
+	bool sleep(std::chrono::steady_clock::duration delay, std::chrono::steady_clock::time_point start);
+
+	// Returns randomized exponential delay before retry
+	std::chrono::steady_clock::duration getBackoffDelay(int attempt,
+		std::chrono::milliseconds initialDelay, std::chrono::milliseconds maxDelay, double jitter);
+
+	static int busyCallback(void* context, int count);
+};
+
+#endif // SQLITEBUSYHANDLER_H
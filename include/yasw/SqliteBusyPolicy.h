@@ -0,0 +1,69 @@
+#ifndef SQLITEBUSYPOLICY_H
+#define SQLITEBUSYPOLICY_H
+
+#include <chrono>
+#include <functional>
+
+/**
+ * Defines how a connection waits for a lock held by another connection.
+ * Sample usage:
+ *		SqliteBusyPolicy policy;
+ *		policy.strategy = SqliteBusyPolicy::Strategy::Backoff;
+ *		policy.timeout = std::chrono::seconds(5);
+ *
+ *		db.setBusyPolicy(policy);
+ */
+struct SqliteBusyPolicy
+{
+	enum class Strategy
+	{
+		// SQLITE_BUSY is returned immediately
+		Fail,
+
+		// Retries with short fixed delays as sqlite3_busy_timeout does until timeout expires
+		Timeout,
+
+		// Retries with exponentially growing randomized delays until timeout expires
+		Backoff,
+
+		// Retries while callback returns true
+		Callback
+	};
+
+	// Receives number of retries made so far and time spent waiting for the lock.
+	// Returns true to retry; may sleep before returning
+	typedef std::function<bool(int attempt, std::chrono::milliseconds elapsed)> TCallback;
+
+	Strategy strategy = Strategy::Fail;
+
+	// Max time to wait for a lock for Timeout and Backoff strategies
+	std::chrono::milliseconds timeout{ 0 };
+
+	// Backoff delay before the first retry; doubled for each following retry up to maxDelay
+	std::chrono::milliseconds initialDelay{ 1 };
+	std::chrono::milliseconds maxDelay{ 100 };
+
+	// Part of backoff delay which is randomized: delay is picked from [delay * (1 - jitter), delay]
+	double jitter = 0.5;
+
+	TCallback callback;
+};
+
+/**
+ * Defines how SqliteDb::withTransaction() repeats transaction failed with SqliteBusyError,
+ * e.g. when a lock was not acquired in time allowed by SqliteBusyPolicy or WAL snapshot became stale.
+ */
+struct SqliteRetryPolicy
+{
+	// Max number of runs of the transaction, including the first one
+	int maxAttempts = 5;
+
+	// Delay before the first retry; doubled for each following retry up to maxDelay
+	std::chrono::milliseconds initialDelay{ 10 };
+	std::chrono::milliseconds maxDelay{ 1000 };
+
+	// Part of delay which is randomized: delay is picked from [delay * (1 - jitter), delay]
+	double jitter = 0.5;
+};
+
+#endif // SQLITEBUSYPOLICY_H
@@ -0,0 +1,77 @@
+#ifndef SQLITECOLUMNBATCH_H
+#define SQLITECOLUMNBATCH_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <initializer_list>
+
+/**
+ * Struct-of-arrays buffers filled by SqliteRecordset::fetchBatch().
+ * Column types are defined once by the caller; buffers keep their capacity across batches,
+ * so a long scan does not allocate per row.
+ * Sample usage:
+ *		SqliteColumnBatch batch{ SqliteColumnBatch::ColumnType::Int64, SqliteColumnBatch::ColumnType::Text };
+ *		auto rs = db.select(sql);
+ *		while (rs.fetchBatch(batch, 1024) > 0)
+ *		{
+ *			const auto& ids = batch.getColumn(0).int64Values;
+ *			// ...
+ *		}
+ */
+class SqliteColumnBatch
+{
+	friend class SqliteRecordset;
+
+public:
+	enum class ColumnType
+	{
+		Int64,
+		Double,
+		Text
+	};
+
+	struct Column
+	{
+		ColumnType type;
+
+		// Values of Int64 column, 0 for NULL
+		std::vector<long long> int64Values;
+
+		// Values of Double column, 0.0 for NULL
+		std::vector<double> doubleValues;
+
+		// Values of Text column: row i occupies textArena[textOffsets[i], textOffsets[i + 1])
+		std::string textArena;
+		std::vector<size_t> textOffsets;
+
+		// Bit (i % 64) of word (i / 64) is set if value in row i IS NULL
+		std::vector<std::uint64_t> nullBitmap;
+	};
+
+	SqliteColumnBatch(std::initializer_list<ColumnType> columnTypes);
+	explicit SqliteColumnBatch(const std::vector<ColumnType>& columnTypes);
+
+	size_t getRowCount() const;
+	size_t getColumnCount() const;
+
+	const Column& getColumn(int index) const;
+
+	// Checks if value in the specified column and row IS NULL
+	bool isNull(int index, size_t row) const;
+
+	// Returns text value in the specified column and row. Valid until the next fetch
+	std::string_view getText(int index, size_t row) const;
+
+	// Removes all rows keeping allocated memory
+	void clear();
+
+private:
+	std::vector<Column> m_columns;
+	size_t m_rowCount;
+
+	void reserve(size_t rowCount);
+};
+
+#endif // SQLITECOLUMNBATCH_H
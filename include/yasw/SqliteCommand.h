@@ -2,9 +2,21 @@
 #define SQLITECOMMAND_H
 
 #include <string>
+#include <string_view>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <vector>
+#include <ranges>
+#include <chrono>
+#include <type_traits>
 #include "SqliteRecordset.h"
+#include "SqliteTransaction.h"
 
 class SqliteDb;
+class SqliteStatementCache;
+class SqliteBusyHandler;
+class SqliteArray;
 
 /**
  * Use SqliteDb::prepare() function to create instance of SqliteCommand.
@@ -20,6 +32,24 @@ class SqliteDb;
  *   .addParameter(...)
  *   ...
  *   .select();
+ *
+ * Use SqliteDb::preparePersistent() to create a command which can be executed many times:
+ * auto cmd = db.preparePersistent(sql);
+ * for (...)
+ *   cmd.addParameter(...)
+ *     .addParameter(...)
+ *     .execute();
+ *
+ * Use withTimeout() to bound execution time; a statement running longer is interrupted
+ * and throws SqliteInterruptedError:
+ * auto rs = db.prepare(sql)
+ *   .withTimeout(std::chrono::milliseconds(200))
+ *   .select();
+ *
+ * Use executeBatch() to execute a statement for each element of a range:
+ * std::vector<std::tuple<long long, std::string>> rows = ...;
+ * db.prepare(sql)
+ *   .executeBatch(rows);
  */
 class SqliteCommand
 {
@@ -35,27 +65,214 @@ public:
 	SqliteCommand& addParameter(long long value);
 	SqliteCommand& addParameter(double value);
 	SqliteCommand& addParameter(const std::wstring& value);
+	SqliteCommand& addParameter(std::string_view value);
 	SqliteCommand& addParameter(const SqliteRecordset::TDateTime& value);
 	SqliteCommand& addParameterBlob(const unsigned char* buf, int bufSize);
+
+	// Binds blob of size zero bytes to be written later by SqliteBlobStream
+	SqliteCommand& addParameterZeroBlob(size_t size);
 	SqliteCommand& addParameterNull();
 
+	/**
+	 * Binds array to be read by table-valued function yasw_array:
+	 *	db.prepare("select name from students where id in yasw_array(?)")
+	 *	  .addParameterArray(ids)
+	 *	  .select();
+	 * The same statement can be reused for arrays of any length. Elements are copied.
+	 * Integer elements are read as 64-bit integers; std::int64_t is long or long long depending on the platform.
+	 */
+	SqliteCommand& addParameterArray(std::span<const long long> values);
+	SqliteCommand& addParameterArray(std::span<const long> values);
+	SqliteCommand& addParameterArray(std::span<const int> values);
+	SqliteCommand& addParameterArray(std::span<const double> values);
+	SqliteCommand& addParameterArray(std::span<const std::string> values);
+	SqliteCommand& addParameterArray(std::span<const std::string_view> values);
+
+	/**
+	 * Binds values of any supported type: arithmetic types, strings,
+	 * SqliteRecordset::TDateTime, blobs as std::vector<unsigned char> or std::span<const std::byte>,
+	 * std::nullopt/nullptr and std::optional of the former.
+	 */
+	template <class... TValues>
+	SqliteCommand& addParameters(const TValues&... values);
+
 	void execute();
 	SqliteRecordset select();
 
+	/**
+	 * Binds each element of the range by position and executes the statement once per element.
+	 * An element is either a tuple-like value (std::tuple, std::pair, std::array)
+	 * or a single value of a type supported by addParameters().
+	 * Batch runs inside a transaction unless useTransaction is false or a transaction is already active.
+	 * Returns number of executed rows.
+	 */
+	template <std::ranges::input_range TRange>
+	size_t executeBatch(TRange&& rows, bool useTransaction = true);
+
+	// Rewinds statement keeping current bindings; next addParameter() binds the first parameter
+	SqliteCommand& reset();
+
+	// Rewinds statement and clears all bindings; next addParameter() binds the first parameter
+	SqliteCommand& rebind();
+
+	// Persistent command is rewound after execute() and select() instead of releasing its statement
+	bool isPersistent() const;
+
+	/**
+	 * Sets time limit for each following execute(), select() or executeBatch().
+	 * For select() the limit also covers iteration of the returned recordset.
+	 * Deadline is checked every SqliteRecordset::DEADLINE_CHECK_INSTRUCTIONS virtual machine instructions.
+	 */
+	SqliteCommand& withTimeout(std::chrono::milliseconds timeout);
+
 private:
-	SqliteCommand(sqlite3* db, const std::wstring& sql);
+	SqliteCommand(SqliteDb* sqliteDb, sqlite3* db, SqliteStatementCache* statementCache, SqliteBusyHandler* busyHandler, const std::wstring& sql);
+	SqliteCommand(SqliteDb* sqliteDb, sqlite3* db, SqliteStatementCache* statementCache, SqliteBusyHandler* busyHandler, std::string_view sql);
+
+	// Persistent command executing statement owned by SqliteDb
+	SqliteCommand(SqliteDb* sqliteDb, sqlite3* db, SqliteBusyHandler* busyHandler, sqlite3_stmt* preparedStmt);
 
 	SqliteCommand(const SqliteCommand&) = delete;
 	SqliteCommand& operator=(const SqliteCommand&) = delete;
 
+	// Connection the command belongs to; starts batch transactions
+	SqliteDb* m_sqliteDb;
+
 	sqlite3* m_db;
+	SqliteStatementCache* m_statementCache;
+	SqliteBusyHandler* m_busyHandler;
 	sqlite3_stmt* m_preparedStmt;
 
 	int m_parameterCount;
 
+	bool m_persistent;
+
+	std::optional<std::chrono::steady_clock::duration> m_timeout;
+
+	// Returns deadline for an execution starting now
+	std::optional<SqliteRecordset::TDeadline> getDeadline() const;
+
 	void moveFrom(SqliteCommand&& rhs) noexcept;
 
 	void checkStatement();
+
+	// Throws if statement preparation failed or left unprocessed statements in SQL tail
+	void checkPrepared(int res, bool hasTail);
+
+	// Returns prepared statement to the statement cache or rewinds statement owned by SqliteDb
+	void releaseStatement();
+
+	// Executes statement and rewinds it for the next batch row
+	void executeBatchRow(const std::optional<SqliteRecordset::TDeadline>& deadline);
+
+	// Starts batch transaction if requested and not in transaction yet
+	std::optional<SqliteTransaction> beginBatch(bool useTransaction);
+
+	template <class T>
+	void addParameterValue(const T& value);
+
+	// Binds array with sqlite3_bind_pointer; takes ownership of the array
+	SqliteCommand& addParameterArray(SqliteArray* array);
 };
 
+template <class... TValues>
+SqliteCommand&
+SqliteCommand::addParameters(const TValues&... values)
+{
+	(addParameterValue(values), ...);
+	return *this;
+}
+
+template <class T>
+void
+SqliteCommand::addParameterValue(const T& value)
+{
+	if constexpr (SqliteRecordset::IsOptional<T>::value)
+	{
+		if (value.has_value())
+			addParameterValue(value.value());
+		else
+			addParameterNull();
+	}
+	else if constexpr (std::is_same_v<T, std::nullopt_t> || std::is_null_pointer_v<T>)
+		addParameterNull();
+	else if constexpr (std::is_integral_v<T> && sizeof(T) <= sizeof(int) && !std::is_same_v<T, unsigned int>)
+		addParameter(static_cast<int>(value));
+	else if constexpr (std::is_integral_v<T>)
+		addParameter(static_cast<long long>(value));
+	else if constexpr (std::is_floating_point_v<T>)
+		addParameter(static_cast<double>(value));
+	else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+		addParameter(std::string_view(value));
+	else if constexpr (std::is_convertible_v<const T&, const std::wstring&> || std::is_convertible_v<const T&, const wchar_t*>)
+		addParameter(std::wstring(value));
+	else if constexpr (std::is_same_v<T, SqliteRecordset::TDateTime>)
+		addParameter(value);
+	else if constexpr (std::is_same_v<T, std::vector<unsigned char>>)
+		addParameterBlob(value.data(), static_cast<int>(value.size()));
+	else if constexpr (std::is_convertible_v<const T&, std::span<const std::byte>>)
+	{
+		std::span<const std::byte> blob(value);
+		addParameterBlob(reinterpret_cast<const unsigned char*>(blob.data()), static_cast<int>(blob.size()));
+	}
+	else
+		static_assert(sizeof(T) == 0, "Unsupported parameter type");
+}
+
+template <std::ranges::input_range TRange>
+size_t
+SqliteCommand::executeBatch(TRange&& rows, bool useTransaction)
+{
+	checkStatement();
+
+	// Bindings of the previous execution must not leak into the first row
+	rebind();
+
+	auto transaction = beginBatch(useTransaction);
+	const auto deadline = getDeadline();
+	size_t rowCount = 0;
+
+	try
+	{
+		for (const auto& row : rows)
+		{
+			using TRow = std::remove_cvref_t<decltype(row)>;
+
+			if constexpr (requires { std::tuple_size<TRow>::value; })
+			{
+				std::apply([this](const auto&... values) {
+					(addParameterValue(values), ...);
+				}, row);
+			}
+			else
+				addParameterValue(row);
+
+			executeBatchRow(deadline);
+			++rowCount;
+		}
+
+		if (transaction.has_value())
+		{
+			// Statement must not be active during COMMIT
+			reset();
+			transaction->commit();
+		}
+	}
+	catch (...)
+	{
+		// Transaction is rolled back by its destructor which ignores errors, so the original error is rethrown
+		transaction.reset();
+
+		if (!m_persistent)
+			releaseStatement();
+
+		throw;
+	}
+
+	if (!m_persistent)
+		releaseStatement();
+
+	return rowCount;
+}
+
 #endif // SQLITECOMMAND_H
@@ -2,28 +2,68 @@
 #define SQLITEDB_H
 
 #include <string>
+#include <string_view>
+#include <filesystem>
+#include <memory>
+#include <vector>
+#include <span>
+#include <cstddef>
+#include <chrono>
+#include <functional>
+#include <type_traits>
 #include "SqliteRecordset.h"
 #include "SqliteCommand.h"
+#include "SqliteQuery.h"
+#include "SqliteFixedString.h"
+#include "SqliteFunction.h"
+#include "SqliteVirtualTable.h"
+#include "SqliteBlobStream.h"
 #include "SqliteTransaction.h"
+#include "SqliteStatementCache.h"
+#include "SqliteBusyHandler.h"
+#include "SqliteDbOptions.h"
+#include "SqliteProfiler.h"
 #include "SqliteExceptions.h"
 
 struct sqlite3;
+struct sqlite3_stmt;
+
+template <SqliteFixedString TSql, class... TArgs>
+class SqliteStatement;
 
 /// <summary>
 /// Wrapper for sqlite3 library.
 /// Not thread safe.
+/// Every function accepting std::wstring has UTF-8 std::string_view counterpart
+/// which maps directly to UTF-8 sqlite3 API.
 /// </summary>
 class SqliteDb
 {
+	template <SqliteFixedString TSql, class... TArgs>
+	friend class SqliteStatement;
+
+	friend class SqliteTransaction;
+
 public:
-	SqliteDb(const std::wstring& dbFileName);
+	SqliteDb(const std::wstring& dbFileName, const SqliteDbOptions& options = SqliteDbOptions());
+	SqliteDb(std::string_view dbFileName, const SqliteDbOptions& options = SqliteDbOptions());
+
+	/**
+	 * Opens in-memory database from image returned by serialize().
+	 * If copyImage is false, image is used in place without copying: database is read-only
+	 * and image must outlive this instance.
+	 */
+	SqliteDb(std::span<const std::byte> image, bool copyImage = true, const SqliteDbOptions& options = SqliteDbOptions());
+
 	~SqliteDb();
 
 	// Executes SQL query without adding parameters
 	SqliteRecordset select(const std::wstring& sql);
+	SqliteRecordset select(std::string_view sql);
 
 	// Executes non-query SQL without adding parameters
 	void execute(const std::wstring& sql);
+	void execute(std::string_view sql);
 
 	/**
 	 * Use SqlCommand to add parameters before
@@ -31,20 +71,309 @@ public:
 	 * Check SqlCommand documentation for more info.
 	 */
 	SqliteCommand prepare(const std::wstring& sql);
+	SqliteCommand prepare(std::string_view sql);
+
+	/**
+	 * Same as prepare() but returned command can be executed many times.
+	 * Bindings start over from the first parameter after each execution.
+	 */
+	SqliteCommand preparePersistent(const std::wstring& sql);
+	SqliteCommand preparePersistent(std::string_view sql);
+
+	/**
+	 * Executes query with parameters bound by SqliteCommand::addParameters()
+	 * and returns typed range of its rows:
+	 *	for (auto [id, name] : db.query<long long, std::string_view>("select id, name from students where age > ?", 20))
+	 */
+	template <class... TColumns, class... TArgs>
+	SqliteQuery<TColumns...> query(const std::wstring& sql, const TArgs&... args);
+
+	template <class... TColumns, class... TArgs>
+	SqliteQuery<TColumns...> query(std::string_view sql, const TArgs&... args);
+
+	/**
+	 * Begins transaction, or nested transaction if a transaction is already active.
+	 * Check SqliteTransaction documentation for more info.
+	 * Lifetime of a returned instance cannot exceed lifetime of this instance.
+	 */
+	SqliteTransaction beginTransaction(SqliteTransaction::Mode mode = SqliteTransaction::Mode::Immediate);
+
+	/**
+	 * Runs func(SqliteDb&) in a transaction and returns its result:
+	 *	auto id = db.withTransaction([](SqliteDb& db) {
+	 *		db.execute("update accounts set balance = balance - 10 where id = 1");
+	 *		db.execute("insert into payments (account_id, amount) values (1, 10)");
+	 *		return db.select("select last_insert_rowid()").getInt64(0).value();
+	 *	});
+	 * Transaction is committed if func returns, rolled back if it throws.
+	 * On SqliteBusyError the transaction is rolled back and run again after a delay, so func
+	 * must be safe to repeat. Nested transaction is not repeated since locks are held by enclosing one.
+	 */
+	template <class TFunc>
+	std::invoke_result_t<TFunc&, SqliteDb&> withTransaction(TFunc&& func,
+		const SqliteRetryPolicy& retryPolicy = SqliteRetryPolicy(),
+		SqliteTransaction::Mode mode = SqliteTransaction::Mode::Immediate);
+
+	/**
+	 * Aborts statements running on this connection; their steps throw SqliteInterruptedError.
+	 * Statements started after all running statements have finished are not affected.
+	 * Can be called from any thread.
+	 */
+	void interrupt();
+
+	/**
+	 * Opens blob in the column of the row for incremental reading and writing.
+	 * Lifetime of a returned instance cannot exceed lifetime of this instance.
+	 */
+	SqliteBlobStream openBlob(std::string_view table, std::string_view column, long long rowid,
+		bool writable = false, std::string_view database = "main");
+
+	// Receives number of pages left to copy and total number of pages after each backup step
+	typedef std::function<void(int remainingPages, int totalPages)> TBackupProgress;
+
+	/**
+	 * Copies main database into target database with online backup API, replacing target content.
+	 * Copies pagesPerStep pages per step, all pages at once if pagesPerStep is negative.
+	 * Source is locked only during a step; between steps the thread sleeps for stepPause
+	 * or yields if stepPause is zero, so that writers are not starved.
+	 * Backup is restarted by SQLite if source is modified by another connection.
+	 */
+	void backupTo(SqliteDb& target, int pagesPerStep = -1,
+		TBackupProgress progress = nullptr, std::chrono::milliseconds stepPause = std::chrono::milliseconds(0));
+	void backupTo(const std::wstring& targetFileName, int pagesPerStep = -1,
+		TBackupProgress progress = nullptr, std::chrono::milliseconds stepPause = std::chrono::milliseconds(0));
+	void backupTo(std::string_view targetFileName, int pagesPerStep = -1,
+		TBackupProgress progress = nullptr, std::chrono::milliseconds stepPause = std::chrono::milliseconds(0));
+
+	/**
+	 * Replaces content of this database with content of the source database, e.g. to load
+	 * a file into in-memory database:
+	 *	SqliteDb db(":memory:");
+	 *	db.restoreFrom("/data/reference.db");
+	 */
+	void restoreFrom(SqliteDb& source, int pagesPerStep = -1, TBackupProgress progress = nullptr);
+	void restoreFrom(const std::wstring& sourceFileName, int pagesPerStep = -1, TBackupProgress progress = nullptr);
+	void restoreFrom(std::string_view sourceFileName, int pagesPerStep = -1, TBackupProgress progress = nullptr);
+
+	// Returns image of main database as it would be stored on disk
+	std::vector<std::byte> serialize() const;
+
+	/**
+	 * Registers function object as SQL scalar function, replacing function with the same name and number of arguments.
+	 * Argument and result types are deduced from the function signature, see SqliteFunction for supported types:
+	 *	db.createFunction("discount", [](double price, std::optional<double> rate) { return price * (1 - rate.value_or(0)); }, true);
+	 * Deterministic function always returns the same result for the same arguments,
+	 * so SQLite can use it in indexes and evaluate it once per statement.
+	 */
+	template <class TFunc>
+	void createFunction(std::string_view name, TFunc&& func, bool deterministic = false);
+
+	/**
+	 * Registers class as SQL aggregate function, or as aggregate window function
+	 * if the class has inverse() and value() members. See SqliteFunction for requirements:
+	 *	struct Average
+	 *	{
+	 *		double sum = 0;
+	 *		long long count = 0;
+	 *
+	 *		void step(double value) { sum += value; ++count; }
+	 *		void inverse(double value) { sum -= value; --count; }
+	 *		std::optional<double> value() const { return count > 0 ? std::optional(sum / count) : std::nullopt; }
+	 *		std::optional<double> final() { return value(); }
+	 *	};
+	 *
+	 *	db.createAggregate<Average>("average");
+	 */
+	template <class TAggregate>
+	void createAggregate(std::string_view name, bool deterministic = false);
+
+	/**
+	 * Publishes rows as read-only eponymous virtual table, replacing table registered with the same name.
+	 * Check SqliteVirtualTable documentation for more info.
+	 */
+	template <class TRow>
+	void createVirtualTable(std::string_view name, const SqliteVirtualTable<TRow>& table);
+
+	// Sets max number of prepared statements kept for reuse. 0 disables statement caching
+	void setStatementCacheCapacity(size_t capacity);
 
-	// Lifetime of a returned instance cannot exceed lifetime of this instance
-	SqliteTransaction beginTransaction();
+	// Returns statement cache hit/miss/eviction counters
+	const SqliteStatementCache::Stats& getStatementCacheStats() const;
+
+	const SqliteDbOptions& getOptions() const;
+
+	/**
+	 * Sets how to wait for locks held by other connections.
+	 * A first step of a statement which found a lock busy without waiting for it (e.g. when waiting
+	 * could deadlock) is also repeated according to the policy, unless it is inside explicit transaction
+	 * and is not read-only. Transaction begin is such a step, too.
+	 * Steps failed to acquire a lock throw SqliteBusyError.
+	 */
+	void setBusyPolicy(const SqliteBusyPolicy& policy);
+
+	// Returns lock contention counters. Can be called from any thread
+	SqliteBusyHandler::Stats getBusyStats() const;
+
+	// Starts/stops collecting per-statement execution statistics. Collected statistics are kept
+	void setProfilingEnabled(bool enabled);
+
+	// Returns statistics collected so far. Can be called from any thread
+	std::vector<SqliteStatementProfile> getProfileSnapshot() const;
+
+	// Discards collected statistics
+	void resetProfile();
 
 private:
-	std::wstring m_dbFileName;
+	std::filesystem::path m_dbFilePath;
+	SqliteDbOptions m_options;
 	sqlite3* m_db;
 
+	SqliteStatementCache m_statementCache;
+
+	SqliteBusyHandler m_busyHandler;
+
+	// Created disabled on open; not replaced while the connection is open, so snapshots need no locking of the pointer
+	std::unique_ptr<SqliteProfiler> m_profiler;
+
+	// Statements of SqliteStatement<> types indexed by their slots; prepared on first use
+	std::vector<sqlite3_stmt*> m_fixedStatements;
+
+	// Ids of active SqliteTransaction instances, from outermost to innermost
+	std::vector<unsigned long long> m_activeTransactions;
+
+	// Id of the next SqliteTransaction
+	unsigned long long m_nextTransactionId;
+
+	// Returns unique slot for a SqliteStatement<> type
+	static size_t allocateStatementSlot();
+
+	// Waits before retry of rolled back transaction. Returns false if it must not be retried
+	bool waitTransactionRetry(int attempt, const SqliteRetryPolicy& retryPolicy);
+
+	// Returns command bound to the statement in the slot, prepares the statement if needed
+	SqliteCommand prepareStatement(size_t slot, std::string_view sql);
+
+	// Calls sqlite3_create_function_v2. userData is destroyed by SQLite, also on failure
+	void registerFunction(std::string_view name, int argCount, bool deterministic,
+		void* userData, SqliteFunction::TCallback callback, SqliteFunction::TDestroy destroy);
+
+	// Calls sqlite3_create_window_function. value and inverse are nullptr for aggregate which is not window function
+	void registerAggregate(std::string_view name, int argCount, bool deterministic,
+		SqliteFunction::TCallback step, SqliteFunction::TFinalCallback final,
+		SqliteFunction::TFinalCallback value, SqliteFunction::TCallback inverse);
+
 	void checkCreateDatabaseDirectory();
-	void open();
+	// Loads image into main database before configuring it, if image is not nullptr
+	void open(const std::span<const std::byte>* image = nullptr, bool copyImage = true);
+
+	void deserialize(std::span<const std::byte> image, bool copyImage);
 	void close();
 
-	// Strips filename from full file path and returns just directory
-	static std::wstring getDirectoryFromFilePath(const std::wstring& filePath);
+	// Applies PRAGMAs from m_options
+	void configure();
+
+	// Executes PRAGMA and returns the first column of its first row, if any
+	std::string executePragma(const std::string& pragma);
+
+	// Copies main database of source into main database of target step by step
+	static void backup(sqlite3* source, sqlite3* target, int pagesPerStep,
+		const TBackupProgress& progress, std::chrono::milliseconds stepPause);
 };
 
+template <class... TColumns, class... TArgs>
+SqliteQuery<TColumns...>
+SqliteDb::query(const std::wstring& sql, const TArgs&... args)
+{
+	auto cmd = prepare(sql);
+	cmd.addParameters(args...);
+
+	return SqliteQuery<TColumns...>(cmd);
+}
+
+template <class... TColumns, class... TArgs>
+SqliteQuery<TColumns...>
+SqliteDb::query(std::string_view sql, const TArgs&... args)
+{
+	auto cmd = prepare(sql);
+	cmd.addParameters(args...);
+
+	return SqliteQuery<TColumns...>(cmd);
+}
+
+template <class TFunc>
+std::invoke_result_t<TFunc&, SqliteDb&>
+SqliteDb::withTransaction(TFunc&& func, const SqliteRetryPolicy& retryPolicy, SqliteTransaction::Mode mode)
+{
+	for (int attempt = 0; ; ++attempt)
+	{
+		try
+		{
+			// Transaction is rolled back on destruction if not committed
+			auto transaction = beginTransaction(mode);
+
+			if constexpr (std::is_void_v<std::invoke_result_t<TFunc&, SqliteDb&>>)
+			{
+				func(*this);
+				transaction.commit();
+
+				return;
+			}
+			else
+			{
+				auto result = func(*this);
+				transaction.commit();
+
+				return result;
+			}
+		}
+		catch (const SqliteBusyError&)
+		{
+			if (!waitTransactionRetry(attempt, retryPolicy))
+				throw;
+		}
+	}
+}
+
+template <class TFunc>
+void
+SqliteDb::createFunction(std::string_view name, TFunc&& func, bool deterministic)
+{
+	typedef std::decay_t<TFunc> TFunction;
+
+	registerFunction(name, SqliteFunctionTraits<TFunction>::ARGUMENT_COUNT, deterministic,
+		new TFunction(std::forward<TFunc>(func)),
+		&SqliteFunction::call<TFunction>,
+		&SqliteFunction::destroy<TFunction>);
+}
+
+template <class TAggregate>
+void
+SqliteDb::createAggregate(std::string_view name, bool deterministic)
+{
+	constexpr bool isWindowFunction = requires { &TAggregate::inverse; &TAggregate::value; };
+	static_assert(isWindowFunction || !requires { &TAggregate::inverse; },
+		"Window function requires both inverse() and value()");
+
+	SqliteFunction::TFinalCallback value = nullptr;
+	SqliteFunction::TCallback inverse = nullptr;
+
+	if constexpr (isWindowFunction)
+	{
+		value = &SqliteFunction::aggregateValue<TAggregate>;
+		inverse = &SqliteFunction::aggregateInverse<TAggregate>;
+	}
+
+	registerAggregate(name, SqliteFunctionTraits<decltype(&TAggregate::step)>::ARGUMENT_COUNT, deterministic,
+		&SqliteFunction::aggregateStep<TAggregate>,
+		&SqliteFunction::aggregateFinal<TAggregate>,
+		value, inverse);
+}
+
+template <class TRow>
+void
+SqliteDb::createVirtualTable(std::string_view name, const SqliteVirtualTable<TRow>& table)
+{
+	SqliteVirtualTableSource::registerModule(m_db, name, new SqliteVirtualTable<TRow>(table));
+}
+
 #endif // SQLITEDB_H
@@ -0,0 +1,98 @@
+#ifndef SQLITEDBOPTIONS_H
+#define SQLITEDBOPTIONS_H
+
+#include <string>
+#include <optional>
+#include <chrono>
+#include "SqliteBusyPolicy.h"
+
+/**
+ * Connection options applied by SqliteDb on open.
+ * Unset optional values leave SQLite defaults intact.
+ * Sample usage:
+ *		SqliteDbOptions options;
+ *		options.journalMode = SqliteDbOptions::JournalMode::Wal;
+ *		options.synchronous = SqliteDbOptions::Synchronous::Normal;
+ *		options.busyTimeout = std::chrono::seconds(5);
+ *
+ *		SqliteDb db(L"/tmp/test.db", options);
+ */
+struct SqliteDbOptions
+{
+	enum class JournalMode
+	{
+		Delete,
+		Truncate,
+		Persist,
+		Memory,
+		Wal,
+		Off
+	};
+
+	enum class Synchronous
+	{
+		Off,
+		Normal,
+		Full,
+		Extra
+	};
+
+	enum class LockingMode
+	{
+		Normal,
+		Exclusive
+	};
+
+	enum class TempStore
+	{
+		Default,
+		File,
+		Memory
+	};
+
+	inline static const size_t DEFAULT_STATEMENT_CACHE_CAPACITY{ 32 };
+
+	// PRAGMA journal_mode. Defaults to MEMORY as in previous versions
+	std::optional<JournalMode> journalMode{ JournalMode::Memory };
+
+	// PRAGMA temp_store. Defaults to MEMORY as in previous versions
+	std::optional<TempStore> tempStore{ TempStore::Memory };
+
+	// PRAGMA synchronous
+	std::optional<Synchronous> synchronous;
+
+	// PRAGMA locking_mode
+	std::optional<LockingMode> lockingMode;
+
+	// PRAGMA cache_size: number of pages if positive, KiB if negative
+	std::optional<int> cacheSize;
+
+	// PRAGMA page_size. Has no effect on existing WAL databases
+	std::optional<int> pageSize;
+
+	// PRAGMA mmap_size in bytes
+	std::optional<long long> mmapSize;
+
+	// Same as busyPolicy with SqliteBusyPolicy::Strategy::Timeout
+	std::optional<std::chrono::milliseconds> busyTimeout;
+
+	// Waiting for locks held by other connections. Takes precedence over busyTimeout
+	std::optional<SqliteBusyPolicy> busyPolicy;
+
+	// SQLITE_OPEN_READONLY instead of SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE
+	bool readOnly = false;
+
+	// SQLITE_OPEN_NOMUTEX
+	bool noMutex = false;
+
+	// SQLITE_OPEN_URI: file name is interpreted as URI
+	bool uri = false;
+
+	// Name of VFS to use. Default VFS if empty
+	std::string vfs;
+
+	// Max number of prepared statements kept for reuse. 0 disables statement caching
+	size_t statementCacheCapacity = DEFAULT_STATEMENT_CACHE_CAPACITY;
+};
+
+#endif // SQLITEDBOPTIONS_H
@@ -0,0 +1,108 @@
+#ifndef SQLITEDBPOOL_H
+#define SQLITEDBPOOL_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include "SqliteDb.h"
+
+/**
+ * Pool of connections to the same database file:
+ * one writer connection and a number of read-only connections, all in WAL mode.
+ * Thread safe. Each connection has its own statement cache.
+ * A connection is checked out with a lease and returned on its destruction.
+ * Threads waiting for a connection are served in FIFO order.
+ * Usage:
+ *		SqliteDbPool pool(L"/tmp/test.db", 4);
+ *
+ *		auto reader = pool.acquireReader();
+ *		auto rs = reader->select(L"select count(*) from students");
+ *
+ *		auto writer = pool.acquireWriter();
+ *		writer->execute(L"delete from students");
+ *
+ * Lifetime of a lease cannot exceed lifetime of the pool.
+ */
+class SqliteDbPool
+{
+	struct WaitQueue;
+
+public:
+	class Lease
+	{
+		friend class SqliteDbPool;
+
+	public:
+		~Lease();
+
+		Lease(Lease&& rhs) noexcept;
+		Lease& operator=(Lease&& rhs) noexcept;
+
+		SqliteDb& operator*() const;
+		SqliteDb* operator->() const;
+
+		// Returns connection to the pool before lease destruction
+		void release();
+
+	private:
+		Lease(SqliteDbPool* pool, WaitQueue* queue, SqliteDb* db);
+
+		Lease(const Lease&) = delete;
+		Lease& operator=(const Lease&) = delete;
+
+		SqliteDbPool* m_pool;
+		WaitQueue* m_queue;
+		SqliteDb* m_db;
+	};
+
+	/**
+	 * Opens the writer connection first, switching the database to WAL mode,
+	 * then readerCount read-only connections; readerCount must be positive.
+	 * Journal mode and open flags of the options are overridden.
+	 */
+	SqliteDbPool(const std::wstring& dbFileName, size_t readerCount, const SqliteDbOptions& options = SqliteDbOptions());
+	SqliteDbPool(std::string_view dbFileName, size_t readerCount, const SqliteDbOptions& options = SqliteDbOptions());
+	~SqliteDbPool();
+
+	// Blocks until the writer connection is available
+	Lease acquireWriter();
+
+	// Blocks until one of read-only connections is available
+	Lease acquireReader();
+
+	size_t getReaderCount() const;
+
+private:
+	SqliteDbPool(const SqliteDbPool&) = delete;
+	SqliteDbPool(SqliteDbPool&&) = delete;
+	SqliteDbPool& operator=(const SqliteDbPool&) = delete;
+	SqliteDbPool& operator=(SqliteDbPool&&) = delete;
+
+	// Free connections of one kind and FIFO ticket queue of threads waiting for them
+	struct WaitQueue
+	{
+		std::vector<SqliteDb*> freeConnections;
+		unsigned long long nextTicket = 0;
+		unsigned long long servedTicket = 0;
+		std::condition_variable condition;
+	};
+
+	std::mutex m_mutex;
+
+	std::unique_ptr<SqliteDb> m_writer;
+	std::vector<std::unique_ptr<SqliteDb>> m_readers;
+
+	WaitQueue m_writerQueue;
+	WaitQueue m_readerQueue;
+
+	template <class TFileName>
+	void open(const TFileName& dbFileName, size_t readerCount, const SqliteDbOptions& options);
+
+	Lease acquire(WaitQueue& queue);
+	void release(WaitQueue& queue, SqliteDb* db);
+};
+
+#endif // SQLITEDBPOOL_H
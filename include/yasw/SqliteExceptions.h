@@ -17,6 +17,26 @@ public:
 		: std::logic_error(errorMessage) { }
 };
 
+/**
+ * Statement interrupted by SqliteDb::interrupt() or by expired SqliteCommand::withTimeout() deadline
+ */
+class SqliteInterruptedError : public SqliteError
+{
+public:
+	explicit SqliteInterruptedError(const std::string& errorMessage)
+		: SqliteError(errorMessage) { }
+};
+
+/**
+ * Lock held by another connection was not released in time allowed by SqliteBusyPolicy
+ */
+class SqliteBusyError : public SqliteError
+{
+public:
+	explicit SqliteBusyError(const std::string& errorMessage)
+		: SqliteError(errorMessage) { }
+};
+
 /**
  * Invalid value type requested
  */
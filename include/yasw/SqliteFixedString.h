@@ -0,0 +1,132 @@
+#ifndef SQLITEFIXEDSTRING_H
+#define SQLITEFIXEDSTRING_H
+
+#include <cstddef>
+#include <string_view>
+
+/**
+ * SQL text usable as a template argument: SqliteStatement<"select ...">
+ */
+template <size_t N>
+struct SqliteFixedString
+{
+	char value[N];
+
+	constexpr SqliteFixedString(const char (&str)[N])
+	{
+		for (size_t i = 0; i < N; ++i)
+			value[i] = str[i];
+	}
+
+	// SQL without trailing whitespace and semicolons
+	constexpr std::string_view getSql() const
+	{
+		std::string_view sql(value, N - 1);
+
+		while (!sql.empty() &&
+			(' ' == sql.back() || '\t' == sql.back() || '\r' == sql.back() || '\n' == sql.back() || ';' == sql.back()))
+		{
+			sql.remove_suffix(1);
+		}
+
+		return sql;
+	}
+
+	/**
+	 * Returns number of parameters as numbered by SQLite: anonymous '?' takes the next index,
+	 * ?NNN takes index NNN, and :name, @name and $name take the next index on the first occurrence
+	 * and the same index on repeated occurrences.
+	 * Placeholders inside literals, quoted identifiers and comments are skipped.
+	 */
+	constexpr size_t getParameterCount() const
+	{
+		const std::string_view sql(value, N - 1);
+		size_t count = 0;
+
+		forEachParameter(sql, [&count, sql](std::string_view name, size_t position) {
+			if ('?' == name[0])
+			{
+				size_t index = 0;
+				for (size_t i = 1; i < name.size(); ++i)
+					index = index * 10 + (name[i] - '0');
+
+				count = index > 0 ? (index > count ? index : count) : count + 1;
+				return;
+			}
+
+			bool repeated = false;
+			forEachParameter(sql.substr(0, position), [&repeated, name](std::string_view previous, size_t) {
+				repeated = repeated || previous == name;
+			});
+
+			if (!repeated)
+				++count;
+		});
+
+		return count;
+	}
+
+private:
+	static constexpr bool isIdentifierChar(char ch)
+	{
+		return ('a' <= ch && 'z' >= ch) || ('A' <= ch && 'Z' >= ch) || ('0' <= ch && '9' >= ch) ||
+			'_' == ch || '$' == ch || static_cast<unsigned char>(ch) >= 0x80;
+	}
+
+	// Calls onParameter(name, position) for every placeholder; name includes the prefix character
+	template <class TOnParameter>
+	static constexpr void forEachParameter(std::string_view sql, TOnParameter onParameter)
+	{
+		for (size_t i = 0; i < sql.size(); ++i)
+		{
+			const char ch = sql[i];
+
+			if ('\'' == ch || '"' == ch || '`' == ch || '[' == ch)
+			{
+				// '' inside a literal is an escaped quote which is skipped as two literals
+				const char closing = '[' == ch ? ']' : ch;
+				i = sql.find(closing, i + 1);
+				if (std::string_view::npos == i)
+					break;
+			}
+			else if ('-' == ch && i + 1 < sql.size() && '-' == sql[i + 1])
+			{
+				i = sql.find('\n', i);
+				if (std::string_view::npos == i)
+					break;
+			}
+			else if ('/' == ch && i + 1 < sql.size() && '*' == sql[i + 1])
+			{
+				i = sql.find("*/", i + 2);
+				if (std::string_view::npos == i)
+					break;
+
+				++i;
+			}
+			else if ('?' == ch)
+			{
+				const size_t position = i;
+				while (i + 1 < sql.size() && '0' <= sql[i + 1] && '9' >= sql[i + 1])
+					++i;
+
+				onParameter(sql.substr(position, i + 1 - position), position);
+			}
+			else if ((':' == ch || '@' == ch || '$' == ch) && i + 1 < sql.size() && isIdentifierChar(sql[i + 1]))
+			{
+				const size_t position = i;
+				while (i + 1 < sql.size() && isIdentifierChar(sql[i + 1]))
+					++i;
+
+				onParameter(sql.substr(position, i + 1 - position), position);
+			}
+			else if (isIdentifierChar(ch))
+			{
+				// $ inside an identifier does not start a parameter
+				while (i + 1 < sql.size() && isIdentifierChar(sql[i + 1]))
+					++i;
+			}
+		}
+	}
+};
+
+#endif // SQLITEFIXEDSTRING_H
@@ -0,0 +1,425 @@
+#ifndef SQLITEFUNCTION_H
+#define SQLITEFUNCTION_H
+
+#include <string>
+#include <string_view>
+#include <span>
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <cstddef>
+#include <exception>
+#include <type_traits>
+#include <new>
+#include "SqliteRecordset.h"
+
+struct sqlite3_context;
+struct sqlite3_value;
+
+/**
+ * Deduces argument and result types of a function object or a function pointer.
+ * Generic lambdas are not supported since their types cannot be deduced.
+ */
+template <class TFunc>
+struct SqliteFunctionTraits : SqliteFunctionTraits<decltype(&TFunc::operator())>
+{
+};
+
+template <class TResult, class... TArgs>
+struct SqliteFunctionTraits<TResult(*)(TArgs...)>
+{
+	typedef TResult TResultType;
+	typedef std::tuple<std::remove_cvref_t<TArgs>...> TArguments;
+
+	inline static const int ARGUMENT_COUNT{ sizeof...(TArgs) };
+};
+
+template <class TResult, class... TArgs>
+struct SqliteFunctionTraits<TResult(TArgs...)> : SqliteFunctionTraits<TResult(*)(TArgs...)>
+{
+};
+
+template <class TClass, class TResult, class... TArgs>
+struct SqliteFunctionTraits<TResult(TClass::*)(TArgs...)> : SqliteFunctionTraits<TResult(*)(TArgs...)>
+{
+};
+
+template <class TClass, class TResult, class... TArgs>
+struct SqliteFunctionTraits<TResult(TClass::*)(TArgs...) const> : SqliteFunctionTraits<TResult(*)(TArgs...)>
+{
+};
+
+template <class TResult, class... TArgs>
+struct SqliteFunctionTraits<TResult(*)(TArgs...) noexcept> : SqliteFunctionTraits<TResult(*)(TArgs...)>
+{
+};
+
+template <class TResult, class... TArgs>
+struct SqliteFunctionTraits<TResult(TArgs...) noexcept> : SqliteFunctionTraits<TResult(*)(TArgs...)>
+{
+};
+
+template <class TClass, class TResult, class... TArgs>
+struct SqliteFunctionTraits<TResult(TClass::*)(TArgs...) noexcept> : SqliteFunctionTraits<TResult(*)(TArgs...)>
+{
+};
+
+template <class TClass, class TResult, class... TArgs>
+struct SqliteFunctionTraits<TResult(TClass::*)(TArgs...) const noexcept> : SqliteFunctionTraits<TResult(*)(TArgs...)>
+{
+};
+
+/**
+ * Marshalling between sqlite3_value/sqlite3_context and C++ types
+ * for functions registered with SqliteDb::createFunction().
+ * Argument types: arithmetic types, std::string_view, std::string,
+ * std::span<const std::byte>, std::vector<unsigned char> and std::optional of the former.
+ * Views are valid during the call only.
+ * Arithmetic arguments accept INTEGER and REAL values converted as by CAST; TEXT and BLOB values
+ * are rejected with SqliteInvalidTypeError, as SqliteRecordset getters do. Text and blob arguments
+ * accept values of any type converted by SQLite.
+ * Result types: the same as argument types, std::nullptr_t or void (NULL result).
+ * Non-optional argument receiving NULL makes the result NULL without calling the function.
+ * Exceptions thrown by the function are reported to SQLite as errors.
+ *
+ * Aggregate registered with SqliteDb::createAggregate() is a default constructible class with members:
+ *		void step(TArgs... args);			// adds row to the aggregate
+ *		TResult final();					// returns result of the aggregate
+ * and, for window function, also:
+ *		void inverse(TArgs... args);		// removes the oldest row added by step()
+ *		TResult value() const;				// returns current result
+ * Aggregate instance is constructed in memory of sqlite3_aggregate_context and destroyed after final().
+ * Rows with NULL in a non-optional argument are not passed to step() and inverse().
+ */
+class SqliteFunction
+{
+	friend class SqliteDb;
+
+public:
+	typedef void (*TCallback)(sqlite3_context* context, int argc, sqlite3_value** argv);
+	typedef void (*TDestroy)(void* userData);
+	typedef void (*TFinalCallback)(sqlite3_context* context);
+
+	template <class T>
+	static T getArgument(sqlite3_value* value);
+
+	template <class T>
+	static void setResult(sqlite3_context* context, const T& value);
+
+	// Reports exception being handled as an error of the function
+	static void setError(sqlite3_context* context, std::exception_ptr error);
+
+private:
+	SqliteFunction() = delete;
+
+	static void* getUserData(sqlite3_context* context);
+
+	// sqlite3_aggregate_context; returns nullptr if size is 0 and aggregate context is not allocated yet
+	static void* getAggregateContext(sqlite3_context* context, size_t size);
+
+	static bool isNull(sqlite3_value* value);
+	static long long getInt64(sqlite3_value* value);
+	static double getDouble(sqlite3_value* value);
+	static std::string_view getText(sqlite3_value* value);
+	static std::span<const std::byte> getBlob(sqlite3_value* value);
+
+	static void setResultNull(sqlite3_context* context);
+	static void setResultInt64(sqlite3_context* context, long long value);
+	static void setResultDouble(sqlite3_context* context, double value);
+	static void setResultText(sqlite3_context* context, std::string_view value);
+	static void setResultBlob(sqlite3_context* context, std::span<const std::byte> value);
+
+	// Returns true if any argument bound to a non-optional parameter IS NULL
+	template <class TArguments, size_t... TIndices>
+	static bool hasNullArgument(sqlite3_value** argv, std::index_sequence<TIndices...>);
+
+	template <class TArguments, class TFunc, size_t... TIndices>
+	static decltype(auto) invoke(TFunc&& func, sqlite3_value** argv, std::index_sequence<TIndices...>);
+
+	// sqlite3_create_function_v2 xFunc
+	template <class TFunc>
+	static void call(sqlite3_context* context, int argc, sqlite3_value** argv);
+
+	template <class TFunc>
+	static void destroy(void* userData);
+
+	// Aggregate instance placed in aggregate context which is zero filled by SQLite
+	template <class TAggregate>
+	struct AggregateState
+	{
+		alignas(TAggregate) std::byte storage[sizeof(TAggregate)];
+		bool constructed;
+	};
+
+	// Memory of sqlite3_aggregate_context is 8-byte aligned
+	inline static const size_t MAX_AGGREGATE_ALIGNMENT{ 8 };
+
+	// Returns aggregate instance constructing it on first call. Returns nullptr if create is false and instance does not exist
+	template <class TAggregate>
+	static TAggregate* getAggregate(sqlite3_context* context, bool create);
+
+	// sqlite3_create_window_function xStep, xInverse, xValue, xFinal
+	template <class TAggregate>
+	static void aggregateStep(sqlite3_context* context, int argc, sqlite3_value** argv);
+
+	template <class TAggregate>
+	static void aggregateInverse(sqlite3_context* context, int argc, sqlite3_value** argv);
+
+	template <class TAggregate>
+	static void aggregateValue(sqlite3_context* context);
+
+	template <class TAggregate>
+	static void aggregateFinal(sqlite3_context* context);
+};
+
+template <class T>
+T
+SqliteFunction::getArgument(sqlite3_value* value)
+{
+	if constexpr (SqliteRecordset::IsOptional<T>::value)
+	{
+		if (isNull(value))
+			return T();
+
+		return getArgument<typename T::value_type>(value);
+	}
+	else if constexpr (std::is_integral_v<T>)
+		return static_cast<T>(getInt64(value));
+	else if constexpr (std::is_floating_point_v<T>)
+		return static_cast<T>(getDouble(value));
+	else if constexpr (std::is_same_v<T, std::string_view>)
+		return getText(value);
+	else if constexpr (std::is_same_v<T, std::string>)
+		return std::string(getText(value));
+	else if constexpr (std::is_same_v<T, std::span<const std::byte>>)
+		return getBlob(value);
+	else if constexpr (std::is_same_v<T, std::vector<unsigned char>>)
+	{
+		auto blob = getBlob(value);
+		auto buf = reinterpret_cast<const unsigned char*>(blob.data());
+
+		return std::vector<unsigned char>(buf, buf + blob.size());
+	}
+	else
+		static_assert(sizeof(T) == 0, "Unsupported argument type");
+}
+
+template <class T>
+void
+SqliteFunction::setResult(sqlite3_context* context, const T& value)
+{
+	if constexpr (SqliteRecordset::IsOptional<T>::value)
+	{
+		if (value.has_value())
+			setResult(context, value.value());
+		else
+			setResultNull(context);
+	}
+	else if constexpr (std::is_same_v<T, std::nullopt_t> || std::is_null_pointer_v<T>)
+		setResultNull(context);
+	else if constexpr (std::is_integral_v<T>)
+		setResultInt64(context, static_cast<long long>(value));
+	else if constexpr (std::is_floating_point_v<T>)
+		setResultDouble(context, static_cast<double>(value));
+	else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+		setResultText(context, std::string_view(value));
+	else if constexpr (std::is_same_v<T, std::vector<unsigned char>>)
+		setResultBlob(context, std::as_bytes(std::span(value)));
+	else if constexpr (std::is_convertible_v<const T&, std::span<const std::byte>>)
+		setResultBlob(context, std::span<const std::byte>(value));
+	else
+		static_assert(sizeof(T) == 0, "Unsupported result type");
+}
+
+template <class TArguments, size_t... TIndices>
+bool
+SqliteFunction::hasNullArgument(sqlite3_value** argv, std::index_sequence<TIndices...>)
+{
+	return ((!SqliteRecordset::IsOptional<std::tuple_element_t<TIndices, TArguments>>::value && isNull(argv[TIndices])) || ...);
+}
+
+template <class TArguments, class TFunc, size_t... TIndices>
+decltype(auto)
+SqliteFunction::invoke(TFunc&& func, sqlite3_value** argv, std::index_sequence<TIndices...>)
+{
+	return func(getArgument<std::tuple_element_t<TIndices, TArguments>>(argv[TIndices])...);
+}
+
+template <class TFunc>
+void
+SqliteFunction::call(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+	typedef SqliteFunctionTraits<TFunc> TTraits;
+	typedef typename TTraits::TArguments TArguments;
+
+	// Number of arguments is enforced by SQLite
+	(void)argc;
+
+	const auto indices = std::make_index_sequence<std::tuple_size_v<TArguments>>();
+
+	try
+	{
+		if (hasNullArgument<TArguments>(argv, indices))
+		{
+			setResultNull(context);
+			return;
+		}
+
+		auto& func = *static_cast<TFunc*>(getUserData(context));
+
+		if constexpr (std::is_void_v<typename TTraits::TResultType>)
+		{
+			invoke<TArguments>(func, argv, indices);
+			setResultNull(context);
+		}
+		else
+			setResult(context, invoke<TArguments>(func, argv, indices));
+	}
+	catch (...)
+	{
+		setError(context, std::current_exception());
+	}
+}
+
+template <class TFunc>
+void
+SqliteFunction::destroy(void* userData)
+{
+	delete static_cast<TFunc*>(userData);
+}
+
+template <class TAggregate>
+TAggregate*
+SqliteFunction::getAggregate(sqlite3_context* context, bool create)
+{
+	static_assert(alignof(TAggregate) <= MAX_AGGREGATE_ALIGNMENT, "Aggregate alignment is not supported");
+
+	auto state = static_cast<AggregateState<TAggregate>*>(
+		getAggregateContext(context, create ? sizeof(AggregateState<TAggregate>) : 0));
+
+	if (nullptr == state)
+		return nullptr;
+
+	if (!state->constructed)
+	{
+		if (!create)
+			return nullptr;
+
+		new (state->storage) TAggregate();
+		state->constructed = true;
+	}
+
+	return std::launder(reinterpret_cast<TAggregate*>(state->storage));
+}
+
+template <class TAggregate>
+void
+SqliteFunction::aggregateStep(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+	typedef typename SqliteFunctionTraits<decltype(&TAggregate::step)>::TArguments TArguments;
+
+	// Number of arguments is enforced by SQLite
+	(void)argc;
+
+	const auto indices = std::make_index_sequence<std::tuple_size_v<TArguments>>();
+
+	try
+	{
+		if (hasNullArgument<TArguments>(argv, indices))
+			return;
+
+		auto aggregate = getAggregate<TAggregate>(context, true);
+		if (nullptr == aggregate)
+			throw std::bad_alloc();
+
+		invoke<TArguments>([aggregate](const auto&... args) {
+			aggregate->step(args...);
+		}, argv, indices);
+	}
+	catch (...)
+	{
+		setError(context, std::current_exception());
+	}
+}
+
+template <class TAggregate>
+void
+SqliteFunction::aggregateInverse(sqlite3_context* context, int argc, sqlite3_value** argv)
+{
+	typedef typename SqliteFunctionTraits<decltype(&TAggregate::inverse)>::TArguments TArguments;
+
+	// Number of arguments is enforced by SQLite
+	(void)argc;
+
+	const auto indices = std::make_index_sequence<std::tuple_size_v<TArguments>>();
+
+	try
+	{
+		if (hasNullArgument<TArguments>(argv, indices))
+			return;
+
+		// Rows are removed only after they were added
+		auto aggregate = getAggregate<TAggregate>(context, false);
+		if (nullptr == aggregate)
+			return;
+
+		invoke<TArguments>([aggregate](const auto&... args) {
+			aggregate->inverse(args...);
+		}, argv, indices);
+	}
+	catch (...)
+	{
+		setError(context, std::current_exception());
+	}
+}
+
+template <class TAggregate>
+void
+SqliteFunction::aggregateValue(sqlite3_context* context)
+{
+	try
+	{
+		auto aggregate = getAggregate<TAggregate>(context, false);
+		if (nullptr != aggregate)
+			setResult(context, aggregate->value());
+		else
+		{
+			// Empty window frame
+			const TAggregate emptyAggregate{};
+			setResult(context, emptyAggregate.value());
+		}
+	}
+	catch (...)
+	{
+		setError(context, std::current_exception());
+	}
+}
+
+template <class TAggregate>
+void
+SqliteFunction::aggregateFinal(sqlite3_context* context)
+{
+	auto aggregate = getAggregate<TAggregate>(context, false);
+
+	try
+	{
+		if (nullptr != aggregate)
+			setResult(context, aggregate->final());
+		else
+		{
+			// No rows were aggregated
+			TAggregate emptyAggregate{};
+			setResult(context, emptyAggregate.final());
+		}
+	}
+	catch (...)
+	{
+		setError(context, std::current_exception());
+	}
+
+	// Memory of aggregate context is freed by SQLite
+	if (nullptr != aggregate)
+		aggregate->~TAggregate();
+}
+
+#endif // SQLITEFUNCTION_H
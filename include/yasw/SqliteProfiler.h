@@ -0,0 +1,113 @@
+#ifndef SQLITEPROFILER_H
+#define SQLITEPROFILER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+/**
+ * Execution statistics of statements sharing the same normalized SQL
+ */
+struct SqliteStatementProfile
+{
+	// SQL with literals replaced by '?' and whitespace collapsed
+	std::string sql;
+
+	unsigned long long callCount = 0;
+	unsigned long long rowCount = 0;
+
+	std::chrono::nanoseconds totalTime{ 0 };
+	std::chrono::nanoseconds minTime{ 0 };
+	std::chrono::nanoseconds maxTime{ 0 };
+
+	// Percentiles over the most recent SqliteProfiler::LATENCY_SAMPLE_COUNT executions
+	std::chrono::nanoseconds p50Time{ 0 };
+	std::chrono::nanoseconds p99Time{ 0 };
+
+	// Sums of sqlite3_stmt_status counters
+	unsigned long long fullscanSteps = 0;
+	unsigned long long sortCount = 0;
+	unsigned long long autoindexCount = 0;
+	unsigned long long vmSteps = 0;
+};
+
+/**
+ * Collects per-statement statistics via sqlite3_trace_v2 and sqlite3_stmt_status.
+ * Use SqliteDb::setProfilingEnabled() and SqliteDb::getProfileSnapshot().
+ * Snapshot can be taken from any thread.
+ */
+class SqliteProfiler
+{
+public:
+	explicit SqliteProfiler(sqlite3* db);
+	~SqliteProfiler();
+
+	// Starts/stops collecting statistics; collected statistics are kept
+	void setEnabled(bool enabled);
+	bool isEnabled() const;
+
+	std::vector<SqliteStatementProfile> getSnapshot() const;
+
+	void reset();
+
+	// Replaces string and numeric literals with '?' and collapses whitespace
+	static std::string normalizeSql(std::string_view sql);
+
+	inline static const size_t LATENCY_SAMPLE_COUNT{ 1024 };
+
+	// Number of original SQL texts whose normalized SQL is remembered
+	inline static const size_t NORMALIZED_SQL_CACHE_SIZE{ 1024 };
+
+private:
+	SqliteProfiler(const SqliteProfiler&) = delete;
+	SqliteProfiler(SqliteProfiler&&) = delete;
+	SqliteProfiler& operator=(const SqliteProfiler&) = delete;
+	SqliteProfiler& operator=(SqliteProfiler&&) = delete;
+
+	struct Entry
+	{
+		SqliteStatementProfile profile;
+
+		// Ring buffer of the most recent latencies
+		std::vector<std::chrono::nanoseconds> latencies;
+		size_t nextLatency = 0;
+	};
+
+	struct StringHash
+	{
+		using is_transparent = void;
+
+		size_t operator()(std::string_view sql) const
+		{
+			return std::hash<std::string_view>()(sql);
+		}
+	};
+
+	sqlite3* m_db;
+	bool m_enabled;
+
+	mutable std::mutex m_mutex;
+
+	// Statistics by normalized SQL
+	std::unordered_map<std::string, Entry> m_entries;
+
+	// Normalized SQL by original SQL; emptied once NORMALIZED_SQL_CACHE_SIZE texts are remembered,
+	// since SQL with inline literals is different on every execution
+	std::unordered_map<std::string, std::string, StringHash, std::equal_to<>> m_normalizedSql;
+
+	// Rows returned by statements which are not finished yet
+	std::unordered_map<sqlite3_stmt*, unsigned long long> m_pendingRowCounts;
+
+	static int traceCallback(unsigned int type, void* context, void* p, void* x);
+
+	void onRow(sqlite3_stmt* stmt);
+	void onProfile(sqlite3_stmt* stmt, long long nanoseconds);
+};
+
+#endif // SQLITEPROFILER_H
@@ -0,0 +1,106 @@
+#ifndef SQLITEQUERY_H
+#define SQLITEQUERY_H
+
+#include <tuple>
+#include <utility>
+#include <iterator>
+#include <cstddef>
+#include "SqliteRecordset.h"
+#include "SqliteCommand.h"
+
+class SqliteDb;
+
+/**
+ * Typed range over query results. Column types are mapped at compile time,
+ * see SqliteRecordset::get() for supported types.
+ * Use SqliteDb::query() to create instance of SqliteQuery:
+ *		for (auto [id, name, price] : db.query<long long, std::string_view, std::optional<double>>(sql, args...))
+ *		{
+ *			// ...
+ *		}
+ * Views in a row are valid until the next row is fetched.
+ * The range can be iterated once.
+ */
+template <class... TColumns>
+class SqliteQuery
+{
+	friend class SqliteDb;
+
+public:
+	typedef std::tuple<TColumns...> TRow;
+
+	class Iterator
+	{
+		friend class SqliteQuery;
+
+	public:
+		typedef TRow value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef std::input_iterator_tag iterator_concept;
+
+		Iterator()
+			: m_recordset(nullptr)
+		{
+		}
+
+		TRow operator*() const
+		{
+			return getRow(std::index_sequence_for<TColumns...>());
+		}
+
+		Iterator& operator++()
+		{
+			++(*m_recordset);
+			return *this;
+		}
+
+		void operator++(int)
+		{
+			++(*this);
+		}
+
+		friend bool operator==(const Iterator& it, std::default_sentinel_t)
+		{
+			return !(*it.m_recordset);
+		}
+
+	private:
+		explicit Iterator(SqliteRecordset* recordset)
+			: m_recordset(recordset)
+		{
+		}
+
+		template <size_t... TIndices>
+		TRow getRow(std::index_sequence<TIndices...>) const
+		{
+			return TRow(m_recordset->template get<TColumns>(static_cast<int>(TIndices))...);
+		}
+
+		SqliteRecordset* m_recordset;
+	};
+
+	Iterator begin()
+	{
+		return Iterator(&m_recordset);
+	}
+
+	std::default_sentinel_t end() const
+	{
+		return std::default_sentinel;
+	}
+
+private:
+	explicit SqliteQuery(SqliteCommand& command)
+		: m_recordset(command.select())
+	{
+	}
+
+	SqliteQuery(const SqliteQuery&) = delete;
+	SqliteQuery(SqliteQuery&&) = delete;
+	SqliteQuery& operator=(const SqliteQuery&) = delete;
+	SqliteQuery& operator=(SqliteQuery&&) = delete;
+
+	SqliteRecordset m_recordset;
+};
+
+#endif // SQLITEQUERY_H
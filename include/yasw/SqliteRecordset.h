@@ -2,14 +2,23 @@
 #define SQLITERECORDSET_H
 
 #include <string>
+#include <string_view>
+#include <span>
+#include <cstddef>
 #include <optional>
+#include <vector>
 #include <chrono>
 #include <sstream>
+#include <type_traits>
+#include "SqliteColumnBatch.h"
+#include "SqliteExceptions.h"
 
 struct sqlite3;
 struct sqlite3_stmt;
 
 class SqliteCommand;
+class SqliteStatementCache;
+class SqliteBusyHandler;
 
 /**
  * Sample usage (assume rs is of SqliteRecordset type):
@@ -29,10 +38,13 @@ public:
 
 	typedef std::chrono::time_point<std::chrono::utc_clock> TDateTime;
 
+	// Time after which statement steps are interrupted
+	typedef std::chrono::steady_clock::time_point TDeadline;
+
 	// Checks if more records are available
 	operator bool() const;
 
-	// Moves to the next record;
+	// Moves to the next record. Throws SqliteInterruptedError if interrupted, SqliteError on other errors
 	SqliteRecordset& operator++();
 
 	// Checks if specified column value in the current row IS NULL
@@ -47,6 +59,13 @@ public:
 	// Returns std::wstring value in the specified column in the current row
 	std::optional<std::wstring> getWString(int index) const;
 
+	// Returns UTF-8 std::string value in the specified column in the current row
+	std::optional<std::string> getString(int index) const;
+
+	// Returns UTF-8 text in the specified column in the current row without copying.
+	// The view is valid until the next operator++
+	std::optional<std::string_view> getTextView(int index) const;
+
 	// Returns double value in the specified column in the current row
 	std::optional<double> getDouble(int index) const;
 
@@ -56,8 +75,37 @@ public:
 	// Retrieves blob value from the specified column in the current row
 	std::optional<std::vector<unsigned char>> getBlob(int index) const;
 
+	// Returns blob in the specified column in the current row without copying.
+	// The view is valid until the next operator++
+	std::optional<std::span<const std::byte>> getBlobView(int index) const;
+
+	/**
+	 * Copies the current row and up to maxRows - 1 following rows into the batch column buffers.
+	 * Batch column i receives recordset column i. Previous batch content is discarded.
+	 * Returns number of fetched rows; recordset is left on the first row not fetched.
+	 */
+	size_t fetchBatch(SqliteColumnBatch& batch, size_t maxRows);
+
+	/**
+	 * Returns value in the specified column in the current row as T, chosen at compile time.
+	 * T is an arithmetic type, std::string, std::string_view, std::wstring, TDateTime,
+	 * std::vector<unsigned char>, std::span<const std::byte> or std::optional of the former.
+	 * Views are valid until the next operator++.
+	 * Throws SqliteInvalidTypeError if value IS NULL and T is not std::optional.
+	 */
+	template <class T>
+	T get(int index) const;
+
+	// true if T is std::optional; used to map NULL values at compile time
+	template <class T>
+	struct IsOptional : std::false_type { };
+
+	template <class T>
+	struct IsOptional<std::optional<T>> : std::true_type { };
+
 private:
-	SqliteRecordset(sqlite3* db, sqlite3_stmt* preparedStmt, bool valid);
+	SqliteRecordset(sqlite3* db, SqliteStatementCache* statementCache, SqliteBusyHandler* busyHandler,
+		sqlite3_stmt* preparedStmt, bool valid, bool ownsStatement, const std::optional<TDeadline>& deadline);
 
 	SqliteRecordset(const SqliteRecordset&) = delete;
 	SqliteRecordset(SqliteRecordset&&) = delete;
@@ -68,11 +116,88 @@ private:
 	inline static const char* const DATE_TIME_FORMAT_SAVE{ "{0:%F}T{0:%T%z}" };
 	inline static const char* const DATE_TIME_FORMAT_LOAD{ "%FT%T%z" };
 
+	// Number of virtual machine instructions between deadline checks
+	inline static const int DEADLINE_CHECK_INSTRUCTIONS{ 1000 };
+
 	sqlite3* m_db;
+	SqliteStatementCache* m_statementCache;
+	SqliteBusyHandler* m_busyHandler;
 	sqlite3_stmt* m_preparedStmt;
 
 	// true if more records are available
 	bool m_valid;
+
+	// false if the statement belongs to SqliteDb
+	bool m_ownsStatement;
+
+	// Deadline of the command which created this recordset
+	std::optional<TDeadline> m_deadline;
+
+	/**
+	 * Steps statement, interrupting it with progress handler once deadline is reached.
+	 * If retryBusy is true, the step is the first one and it found a lock busy without waiting
+	 * for it, the step is repeated according to busy policy. Such step is repeated only
+	 * outside of explicit transaction or for read-only statement, so that it is idempotent.
+	 */
+	static int step(sqlite3* db, sqlite3_stmt* stmt, const std::optional<TDeadline>& deadline,
+		SqliteBusyHandler* busyHandler, bool retryBusy);
+
+	// Throws SqliteInterruptedError, SqliteBusyError or SqliteError for result code of failed step
+	[[noreturn]] static void throwStepError(int res, const std::string& errMsg);
+
+	// Column accessors for non-nullable values, throw SqliteInvalidTypeError on NULL or type mismatch
+	long long getInt64Value(int index) const;
+	double getDoubleValue(int index) const;
+	std::string_view getTextValue(int index) const;
+	std::span<const std::byte> getBlobValue(int index) const;
 };
 
+template <class T>
+T
+SqliteRecordset::get(int index) const
+{
+	if constexpr (IsOptional<T>::value)
+	{
+		if (isNull(index))
+			return T();
+
+		return get<typename T::value_type>(index);
+	}
+	else if constexpr (std::is_integral_v<T>)
+		return static_cast<T>(getInt64Value(index));
+	else if constexpr (std::is_floating_point_v<T>)
+		return static_cast<T>(getDoubleValue(index));
+	else if constexpr (std::is_same_v<T, std::string_view>)
+		return getTextValue(index);
+	else if constexpr (std::is_same_v<T, std::string>)
+		return std::string(getTextValue(index));
+	else if constexpr (std::is_same_v<T, std::span<const std::byte>>)
+		return getBlobValue(index);
+	else if constexpr (std::is_same_v<T, std::vector<unsigned char>>)
+	{
+		auto blob = getBlobValue(index);
+		auto buf = reinterpret_cast<const unsigned char*>(blob.data());
+
+		return std::vector<unsigned char>(buf, buf + blob.size());
+	}
+	else if constexpr (std::is_same_v<T, std::wstring>)
+	{
+		auto value = getWString(index);
+		if (!value.has_value())
+			throw SqliteInvalidTypeError();
+
+		return std::move(value.value());
+	}
+	else if constexpr (std::is_same_v<T, TDateTime>)
+	{
+		auto value = getDateTime(index);
+		if (!value.has_value())
+			throw SqliteInvalidTypeError();
+
+		return value.value();
+	}
+	else
+		static_assert(sizeof(T) == 0, "Unsupported column type");
+}
+
 #endif // SQLITERECORDSET_H
@@ -0,0 +1,71 @@
+#ifndef SQLITESTATEMENT_H
+#define SQLITESTATEMENT_H
+
+#include <string_view>
+#include <cstddef>
+#include "SqliteFixedString.h"
+#include "SqliteDb.h"
+
+/**
+ * Statement with SQL known at compile time.
+ * Number of arguments is checked against placeholders in SQL at compile time.
+ * Named parameters (:name, @name, $name) take one argument each, in order of their first occurrence.
+ * Statement is prepared on first use with each SqliteDb and kept until the database is closed,
+ * so no SQL copying, trimming or cache lookup happens on execution.
+ * Usage:
+ *		using InsertStudent = SqliteStatement<"insert into students (name, age) values (?, ?)", std::string_view, int>;
+ *
+ *		InsertStudent::execute(db, "Bob", 20);
+ *
+ * Only one recordset of the same statement can be open per database at a time.
+ */
+template <SqliteFixedString TSql, class... TArgs>
+class SqliteStatement
+{
+public:
+	static_assert(TSql.getParameterCount() == sizeof...(TArgs),
+		"Number of arguments does not match number of SQL parameters");
+
+	static constexpr std::string_view getSql()
+	{
+		return TSql.getSql();
+	}
+
+	static void execute(SqliteDb& db, const TArgs&... args);
+	static SqliteRecordset select(SqliteDb& db, const TArgs&... args);
+
+private:
+	SqliteStatement() = delete;
+
+	// Returns index of the statement in SqliteDb, same for all databases.
+	// Allocated on first use, so that statements can be executed during static initialization
+	static size_t getSlot();
+};
+
+template <SqliteFixedString TSql, class... TArgs>
+size_t
+SqliteStatement<TSql, TArgs...>::getSlot()
+{
+	static const size_t slot = SqliteDb::allocateStatementSlot();
+	return slot;
+}
+
+template <SqliteFixedString TSql, class... TArgs>
+void
+SqliteStatement<TSql, TArgs...>::execute(SqliteDb& db, const TArgs&... args)
+{
+	db.prepareStatement(getSlot(), getSql())
+		.addParameters(args...)
+		.execute();
+}
+
+template <SqliteFixedString TSql, class... TArgs>
+SqliteRecordset
+SqliteStatement<TSql, TArgs...>::select(SqliteDb& db, const TArgs&... args)
+{
+	return db.prepareStatement(getSlot(), getSql())
+		.addParameters(args...)
+		.select();
+}
+
+#endif // SQLITESTATEMENT_H
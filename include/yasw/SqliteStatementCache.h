@@ -0,0 +1,110 @@
+#ifndef SQLITESTATEMENTCACHE_H
+#define SQLITESTATEMENTCACHE_H
+
+#include <string>
+#include <string_view>
+#include <variant>
+#include <list>
+#include <unordered_map>
+
+struct sqlite3_stmt;
+
+/**
+ * LRU cache of prepared statements keyed by SQL text (either UTF-16 or UTF-8).
+ * A cached statement is borrowed by SqliteCommand (and then by SqliteRecordset)
+ * and returned to the cache on destruction of the borrower.
+ * Returned statements are reset and their bindings are cleared instead of being finalized.
+ * A borrowed statement is not handed out again until returned,
+ * so the same SQL may be prepared once more and such a copy is finalized on return.
+ * A borrowed statement may be shared by several borrowers, e.g. persistent command and its recordset;
+ * it is returned by the last of them.
+ * Not thread safe.
+ */
+class SqliteStatementCache
+{
+public:
+	struct Stats
+	{
+		unsigned long long hits = 0;
+		unsigned long long misses = 0;
+		unsigned long long evictions = 0;
+	};
+
+	explicit SqliteStatementCache(size_t capacity);
+	~SqliteStatementCache();
+
+	// Borrows cached statement. Returns nullptr on cache miss
+	sqlite3_stmt* acquire(const std::wstring& sql);
+	sqlite3_stmt* acquire(std::string_view sql);
+
+	// Registers newly prepared statement as borrowed
+	void add(const std::wstring& sql, sqlite3_stmt* stmt);
+	void add(std::string_view sql, sqlite3_stmt* stmt);
+
+	// Adds one more borrower of the borrowed statement
+	void share(sqlite3_stmt* stmt);
+
+	// Returns borrowed statement to the cache or finalizes it if it is not cached,
+	// unless it is still used by another borrower
+	void release(sqlite3_stmt* stmt);
+
+	// Finalizes all cached statements
+	void clear();
+
+	size_t getCapacity() const;
+
+	// Statements exceeding the capacity are evicted. 0 disables caching
+	void setCapacity(size_t capacity);
+
+	const Stats& getStats() const;
+
+private:
+	SqliteStatementCache(const SqliteStatementCache&) = delete;
+	SqliteStatementCache(SqliteStatementCache&&) = delete;
+	SqliteStatementCache& operator=(const SqliteStatementCache&) = delete;
+	SqliteStatementCache& operator=(SqliteStatementCache&&) = delete;
+
+	struct Entry
+	{
+		std::variant<std::wstring, std::string> sql;
+		sqlite3_stmt* stmt;
+		bool borrowed;
+	};
+
+	typedef std::list<Entry> TEntries;
+
+	// Allows lookup of UTF-8 SQL by std::string_view without a copy
+	struct StringHash
+	{
+		using is_transparent = void;
+
+		size_t operator()(std::string_view sql) const
+		{
+			return std::hash<std::string_view>()(sql);
+		}
+	};
+
+	// Most recently used entries go first
+	TEntries m_entries;
+
+	std::unordered_map<std::wstring, TEntries::iterator> m_entriesByWSql;
+	std::unordered_map<std::string, TEntries::iterator, StringHash, std::equal_to<>> m_entriesBySql;
+	std::unordered_map<sqlite3_stmt*, TEntries::iterator> m_entriesByStmt;
+
+	// Number of borrowers besides the first one, by shared statements
+	std::unordered_map<sqlite3_stmt*, size_t> m_shareCounts;
+
+	size_t m_capacity;
+	Stats m_stats;
+
+	template <class TMap, class TSql>
+	sqlite3_stmt* acquire(TMap& entriesBySql, const TSql& sql);
+
+	template <class TMap, class TSql>
+	void add(TMap& entriesBySql, const TSql& sql, sqlite3_stmt* stmt);
+
+	// Finalizes least recently used statements which are not borrowed until capacity is met
+	void evict();
+};
+
+#endif // SQLITESTATEMENTCACHE_H
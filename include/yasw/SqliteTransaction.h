@@ -1,31 +1,83 @@
 #ifndef SQLITETRANSACTION_H
 #define SQLITETRANSACTION_H
 
+#include <cstddef>
+
 class SqliteDb;
 
-// Object lifetime cannot exceed lifetime of SqliteDb instance that was used to create the former
+/**
+ * Transaction started by SqliteDb::beginTransaction().
+ * A transaction begun while another one is active is nested: it is mapped to SAVEPOINT,
+ * its commit releases the savepoint and its rollback undoes changes made since the savepoint only:
+ *		auto transaction = db.beginTransaction();
+ *		// ...
+ *		{
+ *			auto nested = db.beginTransaction();
+ *			// ...
+ *			nested.rollback();
+ *		}
+ *		transaction.commit();
+ *
+ * Nested transactions must be committed before the enclosing ones.
+ * Rollback of a transaction also rolls back its incomplete nested transactions;
+ * they become complete and their rollback does nothing.
+ * Incomplete transaction is rolled back on destruction.
+ * Object lifetime cannot exceed lifetime of SqliteDb instance that was used to create the former.
+ */
 class SqliteTransaction
 {
 	friend class SqliteDb;
 
 public:
+	// Lock acquired by outermost transaction on begin; nested transactions ignore it
+	enum class Mode
+	{
+		// Locks are acquired on first read and write
+		Deferred,
+
+		// Write lock is acquired on begin
+		Immediate,
+
+		// Write lock is acquired on begin, other connections cannot read in rollback journal modes
+		Exclusive
+	};
+
 	~SqliteTransaction();
 
+	SqliteTransaction(SqliteTransaction&& rhs) noexcept;
+
+	// Rolls back this transaction if it is not complete
+	SqliteTransaction& operator=(SqliteTransaction&& rhs);
+
 	void commit();
 	void rollback();
 
+	// true if the transaction is mapped to SAVEPOINT
+	bool isNested() const;
+
 private:
-	explicit SqliteTransaction(SqliteDb* db);
+	SqliteTransaction(SqliteDb* db, Mode mode);
 
 	SqliteTransaction(const SqliteTransaction&) = delete;
-	SqliteTransaction(SqliteTransaction&&) = delete;
 	SqliteTransaction& operator=(const SqliteTransaction&) = delete;
-	SqliteTransaction& operator=(SqliteTransaction&&) = delete;
 
 	SqliteDb* m_db;
 
+	// Unique per connection
+	unsigned long long m_id;
+
+	// Number of transactions of m_db this one is nested in
+	std::size_t m_level;
+
+	bool m_nested;
+
 	// Commited or rolled back
 	bool m_complete;
+
+	// true if neither this transaction nor an enclosing one is complete
+	bool isActive() const;
+
+	void moveFrom(SqliteTransaction&& rhs) noexcept;
 };
 
 #endif // SQLITETRANSACTION_H
@@ -0,0 +1,352 @@
+#ifndef SQLITEVIRTUALTABLE_H
+#define SQLITEVIRTUALTABLE_H
+
+#include <string>
+#include <string_view>
+#include <span>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <algorithm>
+#include <cassert>
+#include <type_traits>
+#include "SqliteFunction.h"
+
+struct sqlite3;
+struct sqlite3_vtab;
+struct sqlite3_vtab_cursor;
+struct sqlite3_index_info;
+struct sqlite3_context;
+struct sqlite3_value;
+
+/**
+ * Read-only rows published as an eponymous virtual table, see SqliteDb::createVirtualTable().
+ * Implements sqlite3_module on top of the abstract row access.
+ */
+class SqliteVirtualTableSource
+{
+	friend class SqliteDb;
+
+public:
+	virtual ~SqliteVirtualTableSource() = default;
+
+	enum class KeyOperator
+	{
+		Equal,
+		Greater,
+		GreaterOrEqual,
+		Less,
+		LessOrEqual
+	};
+
+	enum class ValueType
+	{
+		Integer,
+		Float,
+		Text,
+		Blob,
+		Null
+	};
+
+	// Returns column list of CREATE TABLE statement
+	virtual std::string getColumnDefinitions() const = 0;
+
+	virtual size_t getRowCount() const = 0;
+
+	// Returns index of the column rows are sorted by, -1 if there is no such column
+	virtual int getKeyColumn() const = 0;
+
+	// Returns collation of the key column declared in getColumnDefinitions(); rows are sorted in BINARY collation
+	virtual const char* getKeyCollation() const = 0;
+
+	// Narrows range [first, last) of rows to rows with key matching "key op value"
+	virtual std::pair<size_t, size_t> findKeyRange(KeyOperator op, sqlite3_value* value, size_t first, size_t last) const = 0;
+
+	// Sets value of the column in the row as result of the context
+	virtual void getColumnValue(size_t row, int column, sqlite3_context* context) const = 0;
+
+protected:
+	static ValueType getValueType(sqlite3_value* value);
+
+private:
+	struct Table;
+	struct Cursor;
+
+	// Bits of idxNum: operators of constraints passed to xFilter in this order
+	inline static const int KEY_EQ{ 1 };
+	inline static const int KEY_GT{ 2 };
+	inline static const int KEY_GE{ 4 };
+	inline static const int KEY_LT{ 8 };
+	inline static const int KEY_LE{ 16 };
+
+	// Registers eponymous-only module; source is destroyed by SQLite, also on failure
+	static void registerModule(sqlite3* db, std::string_view name, SqliteVirtualTableSource* source);
+
+	static void destroy(void* source);
+
+	// Virtual table methods
+	static int connect(sqlite3* db, void* aux, int argc, const char* const* argv, sqlite3_vtab** ppVtab, char** pzErr);
+	static int disconnect(sqlite3_vtab* pVtab);
+	static int bestIndex(sqlite3_vtab* pVtab, sqlite3_index_info* pIndexInfo);
+	static int open(sqlite3_vtab* pVtab, sqlite3_vtab_cursor** ppCursor);
+	static int close(sqlite3_vtab_cursor* pCursor);
+	static int filter(sqlite3_vtab_cursor* pCursor, int idxNum, const char* idxStr, int argc, sqlite3_value** argv);
+	static int next(sqlite3_vtab_cursor* pCursor);
+	static int eof(sqlite3_vtab_cursor* pCursor);
+	static int column(sqlite3_vtab_cursor* pCursor, sqlite3_context* context, int index);
+	static int rowid(sqlite3_vtab_cursor* pCursor, long long* pRowid);
+};
+
+/**
+ * Describes how rows of type TRow are published as a virtual table.
+ * Column types are the result types supported by SqliteFunction.
+ * Usage:
+ *		std::vector<Product> products = ...;	// sorted by id
+ *
+ *		db.createVirtualTable("products", SqliteVirtualTable<Product>(products)
+ *			.addKeyColumn("id", &Product::id)
+ *			.addColumn("name", &Product::name));
+ *
+ *		db.select("select o.id, p.name from orders o join products p on p.id = o.product_id");
+ *
+ * Equality and range constraints on the key column are resolved by binary search,
+ * so rows must be sorted by the key column in ascending order (text keys in BINARY collation).
+ * Rows are not copied and must stay unchanged while the table is registered.
+ */
+template <class TRow>
+class SqliteVirtualTable : public SqliteVirtualTableSource
+{
+public:
+	explicit SqliteVirtualTable(std::span<const TRow> rows);
+
+	template <class TValue>
+	SqliteVirtualTable& addColumn(std::string_view name, TValue TRow::* member);
+
+	// Adds column rows are sorted by. Only one key column is allowed
+	template <class TValue>
+	SqliteVirtualTable& addKeyColumn(std::string_view name, TValue TRow::* member);
+
+	std::string getColumnDefinitions() const override;
+	size_t getRowCount() const override;
+	int getKeyColumn() const override;
+	const char* getKeyCollation() const override;
+	std::pair<size_t, size_t> findKeyRange(KeyOperator op, sqlite3_value* value, size_t first, size_t last) const override;
+	void getColumnValue(size_t row, int column, sqlite3_context* context) const override;
+
+private:
+	struct Column
+	{
+		std::string definition;
+		std::function<void(const TRow& row, sqlite3_context* context)> getValue;
+	};
+
+	typedef std::function<std::pair<size_t, size_t>(std::span<const TRow> rows,
+		KeyOperator op, sqlite3_value* value, size_t first, size_t last)> TFindKeyRange;
+
+	std::span<const TRow> m_rows;
+	std::vector<Column> m_columns;
+
+	int m_keyColumn;
+	TFindKeyRange m_findKeyRange;
+
+	// Returns declared type of column
+	template <class TValue>
+	static const char* getColumnType();
+
+	// Converts value to the type comparable with the key column
+	template <class TValue>
+	static std::pair<size_t, size_t> findKeyRangeByValue(std::span<const TRow> rows, TValue TRow::* member,
+		KeyOperator op, sqlite3_value* value, size_t first, size_t last);
+
+	template <class TValue, class TKey>
+	static std::pair<size_t, size_t> findKeyRangeByKey(std::span<const TRow> rows, TValue TRow::* member,
+		KeyOperator op, const TKey& key, size_t first, size_t last);
+};
+
+template <class TRow>
+SqliteVirtualTable<TRow>::SqliteVirtualTable(std::span<const TRow> rows)
+	: m_rows(rows),
+	  m_keyColumn(-1)
+{
+}
+
+template <class TRow>
+template <class TValue>
+SqliteVirtualTable<TRow>&
+SqliteVirtualTable<TRow>::addColumn(std::string_view name, TValue TRow::* member)
+{
+	std::string definition = "\"";
+	definition += name;
+	definition += "\" ";
+	definition += getColumnType<TValue>();
+
+	m_columns.push_back(Column{ std::move(definition), [member](const TRow& row, sqlite3_context* context) {
+		SqliteFunction::setResult(context, row.*member);
+	} });
+
+	return *this;
+}
+
+template <class TRow>
+template <class TValue>
+SqliteVirtualTable<TRow>&
+SqliteVirtualTable<TRow>::addKeyColumn(std::string_view name, TValue TRow::* member)
+{
+	static_assert(std::is_arithmetic_v<TValue> || std::is_convertible_v<const TValue&, std::string_view>,
+		"Key column must be of arithmetic or string type");
+
+	assert(m_keyColumn < 0);
+	assert(std::is_sorted(m_rows.begin(), m_rows.end(), [member](const TRow& lhs, const TRow& rhs) {
+		return lhs.*member < rhs.*member;
+	}));
+
+	m_keyColumn = static_cast<int>(m_columns.size());
+	m_findKeyRange = [member](std::span<const TRow> rows, KeyOperator op, sqlite3_value* value, size_t first, size_t last) {
+		return findKeyRangeByValue(rows, member, op, value, first, last);
+	};
+
+	return addColumn(name, member);
+}
+
+template <class TRow>
+std::string
+SqliteVirtualTable<TRow>::getColumnDefinitions() const
+{
+	std::string definitions;
+
+	for (const auto& column : m_columns)
+	{
+		if (!definitions.empty())
+			definitions += ", ";
+
+		definitions += column.definition;
+	}
+
+	return definitions;
+}
+
+template <class TRow>
+size_t
+SqliteVirtualTable<TRow>::getRowCount() const
+{
+	return m_rows.size();
+}
+
+template <class TRow>
+int
+SqliteVirtualTable<TRow>::getKeyColumn() const
+{
+	return m_keyColumn;
+}
+
+template <class TRow>
+const char*
+SqliteVirtualTable<TRow>::getKeyCollation() const
+{
+	// Columns are declared without COLLATE
+	return "BINARY";
+}
+
+template <class TRow>
+std::pair<size_t, size_t>
+SqliteVirtualTable<TRow>::findKeyRange(KeyOperator op, sqlite3_value* value, size_t first, size_t last) const
+{
+	assert(m_findKeyRange);
+	return m_findKeyRange(m_rows, op, value, first, last);
+}
+
+template <class TRow>
+void
+SqliteVirtualTable<TRow>::getColumnValue(size_t row, int column, sqlite3_context* context) const
+{
+	m_columns[column].getValue(m_rows[row], context);
+}
+
+template <class TRow>
+template <class TValue>
+const char*
+SqliteVirtualTable<TRow>::getColumnType()
+{
+	if constexpr (SqliteRecordset::IsOptional<TValue>::value)
+		return getColumnType<typename TValue::value_type>();
+	else if constexpr (std::is_integral_v<TValue>)
+		return "INTEGER";
+	else if constexpr (std::is_floating_point_v<TValue>)
+		return "REAL";
+	else if constexpr (std::is_convertible_v<const TValue&, std::string_view>)
+		return "TEXT";
+	else
+		return "BLOB";
+}
+
+template <class TRow>
+template <class TValue>
+std::pair<size_t, size_t>
+SqliteVirtualTable<TRow>::findKeyRangeByValue(std::span<const TRow> rows, TValue TRow::* member,
+	KeyOperator op, sqlite3_value* value, size_t first, size_t last)
+{
+	// Values which cannot be compared with keys leave the range as is; SQLite checks the constraint anyway
+	const auto valueType = getValueType(value);
+
+	if constexpr (std::is_arithmetic_v<TValue>)
+	{
+		if (ValueType::Integer == valueType)
+			return findKeyRangeByKey(rows, member, op, SqliteFunction::getArgument<long long>(value), first, last);
+
+		if (ValueType::Float == valueType)
+			return findKeyRangeByKey(rows, member, op, SqliteFunction::getArgument<double>(value), first, last);
+	}
+	else
+	{
+		if (ValueType::Text == valueType)
+			return findKeyRangeByKey(rows, member, op, SqliteFunction::getArgument<std::string_view>(value), first, last);
+	}
+
+	return { first, last };
+}
+
+template <class TRow>
+template <class TValue, class TKey>
+std::pair<size_t, size_t>
+SqliteVirtualTable<TRow>::findKeyRangeByKey(std::span<const TRow> rows, TValue TRow::* member,
+	KeyOperator op, const TKey& key, size_t first, size_t last)
+{
+	const auto begin = rows.begin() + first;
+	const auto end = rows.begin() + last;
+
+	auto lower = [&]() {
+		return std::lower_bound(begin, end, key, [member](const TRow& row, const TKey& key) {
+			return row.*member < key;
+		}) - rows.begin();
+	};
+
+	auto upper = [&]() {
+		return std::upper_bound(begin, end, key, [member](const TKey& key, const TRow& row) {
+			return key < row.*member;
+		}) - rows.begin();
+	};
+
+	switch (op)
+	{
+	case KeyOperator::Equal:
+		return { lower(), upper() };
+
+	case KeyOperator::Greater:
+		return { upper(), last };
+
+	case KeyOperator::GreaterOrEqual:
+		return { lower(), last };
+
+	case KeyOperator::Less:
+		return { first, lower() };
+
+	case KeyOperator::LessOrEqual:
+		return { first, upper() };
+
+	default:
+		assert(0);
+		return { first, last };
+	}
+}
+
+#endif // SQLITEVIRTUALTABLE_H
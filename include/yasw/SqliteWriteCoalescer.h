@@ -0,0 +1,86 @@
+#ifndef SQLITEWRITECOALESCER_H
+#define SQLITEWRITECOALESCER_H
+
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+
+class SqliteDb;
+
+/**
+ * Group commit of small writes.
+ * Write functions submitted from many threads are executed on a background thread
+ * and batched into one transaction per time window or per maxBatchSize writes.
+ * Every write runs inside its own savepoint, so a failed write is rolled back alone
+ * and its exception is delivered through its future.
+ * If the transaction fails to commit, futures of all writes in the batch receive the error.
+ * Usage:
+ *		SqliteWriteCoalescer coalescer(db);
+ *
+ *		auto done = coalescer.submit([](SqliteDb& db) {
+ *			db.prepare(L"insert into students (name) values (?)")
+ *				.addParameter(L"Bob")
+ *				.execute();
+ *		});
+ *
+ *		done.get();
+ *
+ * The SqliteDb instance is used exclusively by the coalescer thread during coalescer lifetime.
+ * Pending writes are committed on destruction.
+ */
+class SqliteWriteCoalescer
+{
+public:
+	typedef std::function<void(SqliteDb&)> TWrite;
+
+	explicit SqliteWriteCoalescer(SqliteDb& db,
+		size_t maxBatchSize = DEFAULT_MAX_BATCH_SIZE,
+		std::chrono::microseconds maxDelay = DEFAULT_MAX_DELAY);
+	~SqliteWriteCoalescer();
+
+	// Thread safe. Future is fulfilled after the write is committed
+	std::future<void> submit(TWrite write);
+
+	inline static const size_t DEFAULT_MAX_BATCH_SIZE{ 256 };
+	inline static const std::chrono::microseconds DEFAULT_MAX_DELAY{ 2000 };
+
+private:
+	SqliteWriteCoalescer(const SqliteWriteCoalescer&) = delete;
+	SqliteWriteCoalescer(SqliteWriteCoalescer&&) = delete;
+	SqliteWriteCoalescer& operator=(const SqliteWriteCoalescer&) = delete;
+	SqliteWriteCoalescer& operator=(SqliteWriteCoalescer&&) = delete;
+
+	struct PendingWrite
+	{
+		TWrite write;
+		std::promise<void> promise;
+	};
+
+	SqliteDb& m_db;
+
+	const size_t m_maxBatchSize;
+	const std::chrono::microseconds m_maxDelay;
+
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque<PendingWrite> m_pendingWrites;
+	bool m_stopping;
+
+	std::thread m_thread;
+
+	void run();
+
+	// Executes batch in one transaction and fulfills futures
+	void commitBatch(std::vector<PendingWrite>& batch);
+
+	// Executes write inside a savepoint. Returns exception thrown by the write, if any
+	std::exception_ptr executeWrite(const TWrite& write);
+};
+
+#endif // SQLITEWRITECOALESCER_H
@@ -0,0 +1,268 @@
+#include <cassert>
+#include "sqlite3.h"
+#include "SqliteArray.h"
+#include "SqliteExceptions.h"
+
+struct SqliteArray::Cursor : sqlite3_vtab_cursor
+{
+	// nullptr if no array was bound
+	const SqliteArray* array;
+	size_t index;
+};
+
+SqliteArray::SqliteArray(std::span<const long long> values)
+	: m_type(ElementType::Int64),
+	  m_size(values.size()),
+	  m_int64Values(values.begin(), values.end())
+{
+}
+
+SqliteArray::SqliteArray(std::span<const long> values)
+	: m_type(ElementType::Int64),
+	  m_size(values.size()),
+	  m_int64Values(values.begin(), values.end())
+{
+}
+
+SqliteArray::SqliteArray(std::span<const int> values)
+	: m_type(ElementType::Int64),
+	  m_size(values.size()),
+	  m_int64Values(values.begin(), values.end())
+{
+}
+
+SqliteArray::SqliteArray(std::span<const double> values)
+	: m_type(ElementType::Double),
+	  m_size(values.size()),
+	  m_doubleValues(values.begin(), values.end())
+{
+}
+
+SqliteArray::SqliteArray(std::span<const std::string> values)
+	: m_type(ElementType::Text),
+	  m_size(values.size())
+{
+	assignTexts(values);
+}
+
+SqliteArray::SqliteArray(std::span<const std::string_view> values)
+	: m_type(ElementType::Text),
+	  m_size(values.size())
+{
+	assignTexts(values);
+}
+
+template <class TText>
+void
+SqliteArray::assignTexts(std::span<const TText> values)
+{
+	size_t arenaSize = 0;
+	for (const auto& value : values)
+		arenaSize += value.size();
+
+	m_textArena.reserve(arenaSize);
+	m_textOffsets.reserve(values.size() + 1);
+	m_textOffsets.push_back(0);
+
+	for (const auto& value : values)
+	{
+		m_textArena.append(value);
+		m_textOffsets.push_back(m_textArena.size());
+	}
+}
+
+void
+SqliteArray::registerModule(sqlite3* db)
+{
+	// Eponymous-only table-valued function: no xCreate
+	static const sqlite3_module module = {
+		0,							// iVersion
+		nullptr,					// xCreate
+		&SqliteArray::connect,		// xConnect
+		&SqliteArray::bestIndex,	// xBestIndex
+		&SqliteArray::disconnect,	// xDisconnect
+		nullptr,					// xDestroy
+		&SqliteArray::open,			// xOpen
+		&SqliteArray::close,		// xClose
+		&SqliteArray::filter,		// xFilter
+		&SqliteArray::next,			// xNext
+		&SqliteArray::eof,			// xEof
+		&SqliteArray::column,		// xColumn
+		&SqliteArray::rowid,		// xRowid
+		nullptr,					// xUpdate
+		nullptr,					// xBegin
+		nullptr,					// xSync
+		nullptr,					// xCommit
+		nullptr,					// xRollback
+		nullptr,					// xFindFunction
+		nullptr,					// xRename
+		nullptr,					// xSavepoint
+		nullptr,					// xRelease
+		nullptr,					// xRollbackTo
+		nullptr,					// xShadowName
+	};
+
+	int res = sqlite3_create_module(db, MODULE_NAME, &module, nullptr);
+	if (SQLITE_OK != res)
+		throw SqliteError(sqlite3_errmsg(db));
+}
+
+void
+SqliteArray::destroy(void* array)
+{
+	delete static_cast<SqliteArray*>(array);
+}
+
+int
+SqliteArray::connect(sqlite3* db, void*, int, const char* const*, sqlite3_vtab** ppVtab, char**)
+{
+	// Column indexes are used in bestIndex() and column()
+	int res = sqlite3_declare_vtab(db, "CREATE TABLE x(value, pointer HIDDEN)");
+	if (SQLITE_OK != res)
+		return res;
+
+	auto vtab = static_cast<sqlite3_vtab*>(sqlite3_malloc(sizeof(sqlite3_vtab)));
+	if (nullptr == vtab)
+		return SQLITE_NOMEM;
+
+	*vtab = sqlite3_vtab{};
+	*ppVtab = vtab;
+
+	sqlite3_vtab_config(db, SQLITE_VTAB_INNOCUOUS);
+
+	return SQLITE_OK;
+}
+
+int
+SqliteArray::disconnect(sqlite3_vtab* pVtab)
+{
+	sqlite3_free(pVtab);
+	return SQLITE_OK;
+}
+
+int
+SqliteArray::bestIndex(sqlite3_vtab*, sqlite3_index_info* pIndexInfo)
+{
+	const int POINTER_COLUMN = 1;
+
+	for (int i = 0; i < pIndexInfo->nConstraint; ++i)
+	{
+		const auto& constraint = pIndexInfo->aConstraint[i];
+		if (POINTER_COLUMN != constraint.iColumn || SQLITE_INDEX_CONSTRAINT_EQ != constraint.op)
+			continue;
+
+		// Table cannot be scanned until the array is known
+		if (!constraint.usable)
+			return SQLITE_CONSTRAINT;
+
+		pIndexInfo->aConstraintUsage[i].argvIndex = 1;
+		pIndexInfo->aConstraintUsage[i].omit = 1;
+		pIndexInfo->idxNum = 1;
+		pIndexInfo->estimatedCost = 1000;
+		pIndexInfo->estimatedRows = 1000;
+
+		return SQLITE_OK;
+	}
+
+	// No array: empty table
+	pIndexInfo->idxNum = 0;
+	pIndexInfo->estimatedCost = 2147483647;
+	pIndexInfo->estimatedRows = 2147483647;
+
+	return SQLITE_OK;
+}
+
+int
+SqliteArray::open(sqlite3_vtab*, sqlite3_vtab_cursor** ppCursor)
+{
+	auto cursor = static_cast<Cursor*>(sqlite3_malloc(sizeof(Cursor)));
+	if (nullptr == cursor)
+		return SQLITE_NOMEM;
+
+	*cursor = Cursor{};
+	*ppCursor = cursor;
+
+	return SQLITE_OK;
+}
+
+int
+SqliteArray::close(sqlite3_vtab_cursor* pCursor)
+{
+	sqlite3_free(pCursor);
+	return SQLITE_OK;
+}
+
+int
+SqliteArray::filter(sqlite3_vtab_cursor* pCursor, int idxNum, const char*, int argc, sqlite3_value** argv)
+{
+	auto cursor = static_cast<Cursor*>(pCursor);
+
+	cursor->array = 1 == idxNum && argc > 0
+		? static_cast<const SqliteArray*>(sqlite3_value_pointer(argv[0], POINTER_TYPE))
+		: nullptr;
+	cursor->index = 0;
+
+	return SQLITE_OK;
+}
+
+int
+SqliteArray::next(sqlite3_vtab_cursor* pCursor)
+{
+	++static_cast<Cursor*>(pCursor)->index;
+	return SQLITE_OK;
+}
+
+int
+SqliteArray::eof(sqlite3_vtab_cursor* pCursor)
+{
+	auto cursor = static_cast<Cursor*>(pCursor);
+	return nullptr == cursor->array || cursor->index >= cursor->array->m_size;
+}
+
+int
+SqliteArray::column(sqlite3_vtab_cursor* pCursor, sqlite3_context* context, int index)
+{
+	auto cursor = static_cast<Cursor*>(pCursor);
+	auto array = cursor->array;
+	const auto i = cursor->index;
+
+	// Hidden pointer column is not readable
+	if (0 != index)
+	{
+		sqlite3_result_null(context);
+		return SQLITE_OK;
+	}
+
+	switch (array->m_type)
+	{
+	case ElementType::Int64:
+		sqlite3_result_int64(context, array->m_int64Values[i]);
+		break;
+
+	case ElementType::Double:
+		sqlite3_result_double(context, array->m_doubleValues[i]);
+		break;
+
+	case ElementType::Text:
+		{
+			const auto offset = array->m_textOffsets[i];
+			const auto size = array->m_textOffsets[i + 1] - offset;
+
+			sqlite3_result_text64(context, array->m_textArena.data() + offset, size, SQLITE_TRANSIENT, SQLITE_UTF8);
+		}
+		break;
+
+	default:
+		assert(0);
+		sqlite3_result_null(context);
+	}
+
+	return SQLITE_OK;
+}
+
+int
+SqliteArray::rowid(sqlite3_vtab_cursor* pCursor, long long* pRowid)
+{
+	*pRowid = static_cast<long long>(static_cast<Cursor*>(pCursor)->index) + 1;
+	return SQLITE_OK;
+}
@@ -0,0 +1,160 @@
+#include "SqliteAsyncDb.h"
+
+SqliteAsyncDb::SqliteAsyncDb(const std::wstring& dbFileName, const SqliteDbOptions& options)
+	: m_head(&m_stub),
+	  m_tail(&m_stub),
+	  m_pendingJobCount(0)
+{
+	start([dbFileName, options]() {
+		return std::make_unique<SqliteDb>(dbFileName, options);
+	});
+}
+
+SqliteAsyncDb::SqliteAsyncDb(std::string_view dbFileName, const SqliteDbOptions& options)
+	: m_head(&m_stub),
+	  m_tail(&m_stub),
+	  m_pendingJobCount(0)
+{
+	start([dbFileName = std::string(dbFileName), options]() {
+		return std::make_unique<SqliteDb>(dbFileName, options);
+	});
+}
+
+SqliteAsyncDb::~SqliteAsyncDb()
+{
+	// Jobs pushed before the stop marker are executed
+	push(&m_stopJob);
+	m_thread.join();
+}
+
+void
+SqliteAsyncDb::setExecutor(TExecutor executor)
+{
+	m_executor = std::move(executor);
+}
+
+void
+SqliteAsyncDb::resume(std::coroutine_handle<> handle)
+{
+	if (m_executor)
+		m_executor(handle);
+	else
+		handle.resume();
+}
+
+void
+SqliteAsyncDb::start(std::function<std::unique_ptr<SqliteDb>()> openDb)
+{
+	std::promise<void> opened;
+	auto openedFuture = opened.get_future();
+
+	// Promise is owned by the worker since it may be still in use after the future is ready
+	m_thread = std::thread([this, openDb = std::move(openDb), opened = std::move(opened)]() mutable {
+		run(openDb, opened);
+	});
+
+	try
+	{
+		openedFuture.get();
+	}
+	catch (...)
+	{
+		m_thread.join();
+		throw;
+	}
+}
+
+void
+SqliteAsyncDb::run(const std::function<std::unique_ptr<SqliteDb>()>& openDb, std::promise<void>& opened)
+{
+	// Connection is used by this thread only
+	std::unique_ptr<SqliteDb> db;
+
+	try
+	{
+		db = openDb();
+	}
+	catch (...)
+	{
+		opened.set_exception(std::current_exception());
+		return;
+	}
+
+	opened.set_value();
+
+	for (;;)
+	{
+		m_pendingJobCount.wait(0, std::memory_order_acquire);
+
+		auto job = pop();
+		if (nullptr == job)
+		{
+			// Producer is between exchange of m_head and linking the node
+			std::this_thread::yield();
+			continue;
+		}
+
+		m_pendingJobCount.fetch_sub(1, std::memory_order_relaxed);
+
+		if (&m_stopJob == job)
+			break;
+
+		job->run(*db);
+		delete job;
+	}
+}
+
+void
+SqliteAsyncDb::push(Job* job)
+{
+	job->next.store(nullptr, std::memory_order_relaxed);
+
+	auto prev = m_head.exchange(job, std::memory_order_acq_rel);
+	prev->next.store(job, std::memory_order_release);
+
+	if (&m_stub != job)
+	{
+		m_pendingJobCount.fetch_add(1, std::memory_order_release);
+		m_pendingJobCount.notify_one();
+	}
+}
+
+SqliteAsyncDb::Job*
+SqliteAsyncDb::pop()
+{
+	auto tail = m_tail;
+	auto next = tail->next.load(std::memory_order_acquire);
+
+	// Skip the stub
+	if (&m_stub == tail)
+	{
+		if (nullptr == next)
+			return nullptr;
+
+		m_tail = next;
+		tail = next;
+		next = next->next.load(std::memory_order_acquire);
+	}
+
+	if (nullptr != next)
+	{
+		m_tail = next;
+		return tail;
+	}
+
+	// tail is the last node unless another push is in progress
+	if (m_head.load(std::memory_order_acquire) != tail)
+		return nullptr;
+
+	// Stub becomes the last node, so that tail can be detached
+	push(&m_stub);
+
+	next = tail->next.load(std::memory_order_acquire);
+	if (nullptr != next)
+	{
+		m_tail = next;
+		return tail;
+	}
+
+	return nullptr;
+}
@@ -0,0 +1,70 @@
+#include <cassert>
+#include "sqlite3.h"
+#include "SqliteBlobStream.h"
+#include "SqliteExceptions.h"
+
+SqliteBlobStream::SqliteBlobStream(sqlite3* db, const char* szDatabase, const char* szTable, const char* szColumn, long long rowid, bool writable)
+	: m_db(db),
+	  m_blob(nullptr)
+{
+	assert(m_db);
+
+	auto res = sqlite3_blob_open(m_db, szDatabase, szTable, szColumn, rowid, writable ? 1 : 0, &m_blob);
+	if (SQLITE_OK != res)
+	{
+		std::string errMsg = sqlite3_errmsg(m_db);
+
+		// Handle may be allocated on failure
+		sqlite3_blob_close(m_blob);
+		m_blob = nullptr;
+
+		throw SqliteError(errMsg);
+	}
+}
+
+SqliteBlobStream::~SqliteBlobStream()
+{
+	sqlite3_blob_close(m_blob);
+	m_blob = nullptr;
+}
+
+size_t
+SqliteBlobStream::getSize() const
+{
+	return static_cast<size_t>(sqlite3_blob_bytes(m_blob));
+}
+
+void
+SqliteBlobStream::checkRange(size_t offset, size_t size) const
+{
+	if (offset > getSize() || size > getSize() - offset)
+		throw SqliteError("Blob range out of bounds");
+}
+
+void
+SqliteBlobStream::read(size_t offset, std::span<std::byte> buffer)
+{
+	checkRange(offset, buffer.size());
+
+	auto res = sqlite3_blob_read(m_blob, buffer.data(), static_cast<int>(buffer.size()), static_cast<int>(offset));
+	if (SQLITE_OK != res)
+		throw SqliteError(sqlite3_errmsg(m_db));
+}
+
+void
+SqliteBlobStream::write(size_t offset, std::span<const std::byte> data)
+{
+	checkRange(offset, data.size());
+
+	auto res = sqlite3_blob_write(m_blob, data.data(), static_cast<int>(data.size()), static_cast<int>(offset));
+	if (SQLITE_OK != res)
+		throw SqliteError(sqlite3_errmsg(m_db));
+}
+
+void
+SqliteBlobStream::reopen(long long rowid)
+{
+	auto res = sqlite3_blob_reopen(m_blob, rowid);
+	if (SQLITE_OK != res)
+		throw SqliteError(sqlite3_errmsg(m_db));
+}
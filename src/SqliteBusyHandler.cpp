@@ -0,0 +1,179 @@
+#include <cassert>
+#include <algorithm>
+#include <thread>
+#include "sqlite3.h"
+#include "SqliteBusyHandler.h"
+#include "SqliteExceptions.h"
+
+SqliteBusyHandler::SqliteBusyHandler()
+	: m_random(std::random_device()()),
+	  m_busyCount(0),
+	  m_retryCount(0),
+	  m_failureCount(0),
+	  m_waitMicroseconds(0)
+{
+}
+
+const SqliteBusyPolicy&
+SqliteBusyHandler::getPolicy() const
+{
+	return m_policy;
+}
+
+void
+SqliteBusyHandler::setPolicy(sqlite3* db, const SqliteBusyPolicy& policy)
+{
+	assert(db);
+
+	if (SqliteBusyPolicy::Strategy::Callback == policy.strategy && !policy.callback)
+		throw SqliteError("Busy policy callback is not set");
+
+	m_policy = policy;
+
+	// Also replaces handler installed by sqlite3_busy_timeout
+	auto res = SqliteBusyPolicy::Strategy::Fail == m_policy.strategy
+		? sqlite3_busy_handler(db, nullptr, nullptr)
+		: sqlite3_busy_handler(db, &SqliteBusyHandler::busyCallback, this);
+
+	if (SQLITE_OK != res)
+		throw SqliteError(sqlite3_errmsg(db));
+}
+
+bool
+SqliteBusyHandler::wait(int attempt, std::chrono::steady_clock::time_point start)
+{
+	switch (m_policy.strategy)
+	{
+	case SqliteBusyPolicy::Strategy::Timeout:
+	{
+		const int delayCount = static_cast<int>(std::size(TIMEOUT_DELAYS_MS));
+		return sleep(std::chrono::milliseconds(TIMEOUT_DELAYS_MS[std::min(attempt, delayCount - 1)]), start);
+	}
+
+	case SqliteBusyPolicy::Strategy::Backoff:
+		return sleep(getBackoffDelay(attempt, m_policy.initialDelay, m_policy.maxDelay, m_policy.jitter), start);
+
+	case SqliteBusyPolicy::Strategy::Callback:
+	{
+		const auto callbackStart = std::chrono::steady_clock::now();
+		const bool retry = m_policy.callback(attempt,
+			std::chrono::duration_cast<std::chrono::milliseconds>(callbackStart - start));
+
+		m_waitMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - callbackStart).count();
+
+		return retry;
+	}
+
+	case SqliteBusyPolicy::Strategy::Fail:
+	default:
+		return false;
+	}
+}
+
+bool
+SqliteBusyHandler::wait(int attempt, const SqliteRetryPolicy& retryPolicy)
+{
+	if (attempt + 1 >= retryPolicy.maxAttempts)
+		return false;
+
+	const auto start = std::chrono::steady_clock::now();
+	std::this_thread::sleep_for(getBackoffDelay(attempt, retryPolicy.initialDelay, retryPolicy.maxDelay, retryPolicy.jitter));
+
+	m_waitMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - start).count();
+
+	onRetry();
+
+	return true;
+}
+
+std::chrono::steady_clock::duration
+SqliteBusyHandler::getBackoffDelay(int attempt,
+	std::chrono::milliseconds initialDelay, std::chrono::milliseconds maxDelay, double jitter)
+{
+	// Shift is limited to avoid overflow; the delay is capped by maxDelay anyway
+	auto delay = std::min<std::chrono::steady_clock::duration>(initialDelay * (1LL << std::min(attempt, 30)), maxDelay);
+
+	// Randomized delays prevent connections which failed together from retrying together
+	jitter = std::clamp(jitter, 0.0, 1.0);
+	std::uniform_real_distribution<double> distribution(1.0 - jitter, 1.0);
+
+	return std::chrono::duration_cast<std::chrono::steady_clock::duration>(delay * distribution(m_random));
+}
+
+bool
+SqliteBusyHandler::sleep(std::chrono::steady_clock::duration delay, std::chrono::steady_clock::time_point start)
+{
+	const auto now = std::chrono::steady_clock::now();
+	const auto timeLeft = start + m_policy.timeout - now;
+
+	if (timeLeft <= std::chrono::steady_clock::duration::zero())
+		return false;
+
+	std::this_thread::sleep_for(std::min(delay, timeLeft));
+
+	m_waitMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - now).count();
+
+	return true;
+}
+
+SqliteBusyHandler::Stats
+SqliteBusyHandler::getStats() const
+{
+	Stats stats;
+	stats.busyCount = m_busyCount;
+	stats.retryCount = m_retryCount;
+	stats.failureCount = m_failureCount;
+	stats.waitTime = std::chrono::microseconds(m_waitMicroseconds);
+
+	return stats;
+}
+
+unsigned long long
+SqliteBusyHandler::getBusyCount() const
+{
+	return m_busyCount.load(std::memory_order_relaxed);
+}
+
+void
+SqliteBusyHandler::onBusy()
+{
+	++m_busyCount;
+}
+
+void
+SqliteBusyHandler::onRetry()
+{
+	++m_retryCount;
+}
+
+void
+SqliteBusyHandler::onFailure()
+{
+	++m_failureCount;
+}
+
+int
+SqliteBusyHandler::busyCallback(void* context, int count)
+{
+	auto handler = static_cast<SqliteBusyHandler*>(context);
+
+	// count is reset for every lock
+	if (0 == count)
+	{
+		handler->m_busyStart = std::chrono::steady_clock::now();
+		handler->onBusy();
+	}
+
+	try
+	{
+		return handler->wait(count, handler->m_busyStart) ? 1 : 0;
+	}
+	catch (...)
+	{
+		// Exception must not propagate through SQLite
+		return 0;
+	}
+}
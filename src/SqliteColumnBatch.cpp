@@ -0,0 +1,99 @@
+#include <cassert>
+#include "SqliteColumnBatch.h"
+
+SqliteColumnBatch::SqliteColumnBatch(std::initializer_list<ColumnType> columnTypes)
+	: SqliteColumnBatch(std::vector<ColumnType>(columnTypes))
+{
+}
+
+SqliteColumnBatch::SqliteColumnBatch(const std::vector<ColumnType>& columnTypes)
+	: m_rowCount(0)
+{
+	m_columns.reserve(columnTypes.size());
+	for (auto type : columnTypes)
+	{
+		Column column;
+		column.type = type;
+		column.textOffsets.push_back(0);
+
+		m_columns.push_back(std::move(column));
+	}
+}
+
+size_t
+SqliteColumnBatch::getRowCount() const
+{
+	return m_rowCount;
+}
+
+size_t
+SqliteColumnBatch::getColumnCount() const
+{
+	return m_columns.size();
+}
+
+const SqliteColumnBatch::Column&
+SqliteColumnBatch::getColumn(int index) const
+{
+	return m_columns.at(index);
+}
+
+bool
+SqliteColumnBatch::isNull(int index, size_t row) const
+{
+	assert(row < m_rowCount);
+
+	const auto& bitmap = m_columns.at(index).nullBitmap;
+	return 0 != (bitmap[row / 64] & (std::uint64_t(1) << (row % 64)));
+}
+
+std::string_view
+SqliteColumnBatch::getText(int index, size_t row) const
+{
+	assert(row < m_rowCount);
+
+	const auto& column = m_columns.at(index);
+	assert(ColumnType::Text == column.type);
+
+	const auto begin = column.textOffsets[row];
+	const auto end = column.textOffsets[row + 1];
+
+	return std::string_view(column.textArena).substr(begin, end - begin);
+}
+
+void
+SqliteColumnBatch::clear()
+{
+	for (auto& column : m_columns)
+	{
+		column.int64Values.clear();
+		column.doubleValues.clear();
+		column.textArena.clear();
+		column.textOffsets.resize(1);
+		column.nullBitmap.clear();
+	}
+
+	m_rowCount = 0;
+}
+
+void
+SqliteColumnBatch::reserve(size_t rowCount)
+{
+	for (auto& column : m_columns)
+	{
+		switch (column.type)
+		{
+		case ColumnType::Int64:
+			column.int64Values.reserve(rowCount);
+			break;
+		case ColumnType::Double:
+			column.doubleValues.reserve(rowCount);
+			break;
+		case ColumnType::Text:
+			column.textOffsets.reserve(rowCount + 1);
+			break;
+		}
+
+		column.nullBitmap.reserve((rowCount + 63) / 64);
+	}
+}
@@ -2,40 +2,97 @@
 #include <format>
 #include "sqlite3.h"
 #include "SqliteCommand.h"
+#include "SqliteDb.h"
+#include "SqliteStatementCache.h"
+#include "SqliteArray.h"
 #include "SqliteExceptions.h"
 
-SqliteCommand::SqliteCommand(sqlite3* db, const std::wstring& sql)
-	: m_db(db),
+SqliteCommand::SqliteCommand(SqliteDb* sqliteDb, sqlite3* db, SqliteStatementCache* statementCache, SqliteBusyHandler* busyHandler,
+	const std::wstring& sql)
+	: m_sqliteDb(sqliteDb),
+	  m_db(db),
+	  m_statementCache(statementCache),
+	  m_busyHandler(busyHandler),
 	  m_preparedStmt(nullptr),
-	  m_parameterCount(0)
+	  m_parameterCount(0),
+	  m_persistent(false)
 {
+	assert(m_sqliteDb);
 	assert(m_db);
+	assert(m_statementCache);
+
+	m_preparedStmt = m_statementCache->acquire(sql);
+	if (nullptr != m_preparedStmt)
+		return;
+
+	// Cached statements are expected to be reused many times
+	unsigned int prepFlags = m_statementCache->getCapacity() > 0 ? SQLITE_PREPARE_PERSISTENT : 0;
 
 	const void* pTail = nullptr;
-	auto res = sqlite3_prepare16_v2(m_db, sql.c_str(), -1, &m_preparedStmt, &pTail);
+	auto res = sqlite3_prepare16_v3(m_db, sql.c_str(), -1, prepFlags, &m_preparedStmt, &pTail);
 
-	// Check that no statements left unprocessed
 	auto wszTail = reinterpret_cast<const wchar_t* const>(pTail);
-	if (nullptr != wszTail && L'\0' != *wszTail)
-		throw MultipleStatementsUnsupportedError();
+	checkPrepared(res, nullptr != wszTail && L'\0' != *wszTail);
 
-	if (SQLITE_OK != res)
-		throw SqliteError(sqlite3_errmsg(m_db));
+	m_statementCache->add(sql, m_preparedStmt);
+}
+
+SqliteCommand::SqliteCommand(SqliteDb* sqliteDb, sqlite3* db, SqliteStatementCache* statementCache, SqliteBusyHandler* busyHandler,
+	std::string_view sql)
+	: m_sqliteDb(sqliteDb),
+	  m_db(db),
+	  m_statementCache(statementCache),
+	  m_busyHandler(busyHandler),
+	  m_preparedStmt(nullptr),
+	  m_parameterCount(0),
+	  m_persistent(false)
+{
+	assert(m_sqliteDb);
+	assert(m_db);
+	assert(m_statementCache);
+
+	m_preparedStmt = m_statementCache->acquire(sql);
+	if (nullptr != m_preparedStmt)
+		return;
+
+	// Cached statements are expected to be reused many times
+	unsigned int prepFlags = m_statementCache->getCapacity() > 0 ? SQLITE_PREPARE_PERSISTENT : 0;
+
+	const char* pTail = nullptr;
+	auto res = sqlite3_prepare_v3(m_db, sql.data(), static_cast<int>(sql.size()), prepFlags, &m_preparedStmt, &pTail);
+
+	checkPrepared(res, nullptr != pTail && sql.data() + sql.size() != pTail);
+
+	m_statementCache->add(sql, m_preparedStmt);
+}
+
+SqliteCommand::SqliteCommand(SqliteDb* sqliteDb, sqlite3* db, SqliteBusyHandler* busyHandler, sqlite3_stmt* preparedStmt)
+	: m_sqliteDb(sqliteDb),
+	  m_db(db),
+	  m_statementCache(nullptr),
+	  m_busyHandler(busyHandler),
+	  m_preparedStmt(preparedStmt),
+	  m_parameterCount(0),
+	  m_persistent(true)
+{
+	assert(m_sqliteDb);
+	assert(m_db);
+	assert(m_preparedStmt);
 }
 
 SqliteCommand::~SqliteCommand()
 {
-	if (m_preparedStmt)
-	{
-		sqlite3_finalize(m_preparedStmt);
-		m_preparedStmt = nullptr;
-	}
+	releaseStatement();
 }
 
 SqliteCommand::SqliteCommand(SqliteCommand&& rhs) noexcept
-: m_db(nullptr),
+: m_sqliteDb(nullptr),
+  m_db(nullptr),
+  m_statementCache(nullptr),
+  m_busyHandler(nullptr),
   m_preparedStmt(nullptr),
-  m_parameterCount(0)
+  m_parameterCount(0),
+  m_persistent(false)
 {
 	moveFrom(std::move(rhs));
 }
@@ -50,14 +107,31 @@ SqliteCommand::operator=(SqliteCommand&& rhs) noexcept
 void
 SqliteCommand::moveFrom(SqliteCommand&& rhs) noexcept
 {
+	releaseStatement();
+
+	m_sqliteDb = rhs.m_sqliteDb;
+	rhs.m_sqliteDb = nullptr;
+
 	m_db = rhs.m_db;
 	rhs.m_db = nullptr;
 
+	m_statementCache = rhs.m_statementCache;
+	rhs.m_statementCache = nullptr;
+
+	m_busyHandler = rhs.m_busyHandler;
+	rhs.m_busyHandler = nullptr;
+
 	m_preparedStmt = rhs.m_preparedStmt;
 	rhs.m_preparedStmt = nullptr;
 
 	m_parameterCount = rhs.m_parameterCount;
 	rhs.m_parameterCount = 0;
+
+	m_persistent = rhs.m_persistent;
+	rhs.m_persistent = false;
+
+	m_timeout = rhs.m_timeout;
+	rhs.m_timeout.reset();
 }
 
 void
@@ -70,45 +144,183 @@ SqliteCommand::checkStatement()
 	}
 }
 
+void
+SqliteCommand::checkPrepared(int res, bool hasTail)
+{
+	if (SQLITE_OK != res)
+	{
+		std::string errMsg = sqlite3_errmsg(m_db);
+		sqlite3_finalize(m_preparedStmt);
+		m_preparedStmt = nullptr;
+
+		throw SqliteError(errMsg);
+	}
+
+	// Check that no statements left unprocessed
+	if (hasTail)
+	{
+		sqlite3_finalize(m_preparedStmt);
+		m_preparedStmt = nullptr;
+
+		throw MultipleStatementsUnsupportedError();
+	}
+}
+
+void
+SqliteCommand::releaseStatement()
+{
+	if (m_preparedStmt)
+	{
+		if (nullptr != m_statementCache)
+			m_statementCache->release(m_preparedStmt);
+		else
+		{
+			sqlite3_reset(m_preparedStmt);
+			sqlite3_clear_bindings(m_preparedStmt);
+		}
+
+		m_preparedStmt = nullptr;
+	}
+}
+
 void
 SqliteCommand::execute()
 {
 	checkStatement();
 
-	auto res = sqlite3_step(m_preparedStmt);
+	auto res = SqliteRecordset::step(m_db, m_preparedStmt, getDeadline(), m_busyHandler, true);
 	if (SQLITE_DONE != res)
 	{
 		std::string errMsg = sqlite3_errmsg(m_db);
-		sqlite3_finalize(m_preparedStmt);
-		m_preparedStmt = nullptr;
 
-		throw SqliteError(errMsg);
+		if (m_persistent)
+			reset();
+		else
+			releaseStatement();
+
+		SqliteRecordset::throwStepError(res, errMsg);
 	}
 
-	// Finalize statement in order to prevent further attempts to execute
-	sqlite3_finalize(m_preparedStmt);
-	m_preparedStmt = nullptr;
+	// Non-persistent statement is released in order to prevent further attempts to execute
+	if (m_persistent)
+		reset();
+	else
+		releaseStatement();
 }
 
 SqliteRecordset
 SqliteCommand::select()
 {
-	auto res = sqlite3_step(m_preparedStmt);
+	checkStatement();
+
+	const auto deadline = getDeadline();
+
+	auto res = SqliteRecordset::step(m_db, m_preparedStmt, deadline, m_busyHandler, true);
 	if (SQLITE_DONE != res &&
 		SQLITE_ROW != res)
 	{
 		std::string errMsg = sqlite3_errmsg(m_db);
-		sqlite3_finalize(m_preparedStmt);
+
+		if (m_persistent)
+			reset();
+		else
+			releaseStatement();
+
+		SqliteRecordset::throwStepError(res, errMsg);
+	}
+
+	if (nullptr == m_statementCache)
+	{
+		// Statement is owned by SqliteDb; recordset rewinds it on destruction
+		auto preparedStmt = m_preparedStmt;
 		m_preparedStmt = nullptr;
 
-		throw SqliteError(errMsg);
+		return SqliteRecordset(m_db, nullptr, m_busyHandler, preparedStmt, SQLITE_ROW == res, false, deadline);
+	}
+
+	if (m_persistent)
+	{
+		// Statement is shared with the recordset, so that it outlives the command if needed.
+		// Recordset rewinds it on destruction
+		m_statementCache->share(m_preparedStmt);
+		m_parameterCount = 0;
+
+		return SqliteRecordset(m_db, m_statementCache, m_busyHandler, m_preparedStmt, SQLITE_ROW == res, true, deadline);
 	}
 
 	// Ownership of m_preparedStmt is being transferred to SqliteRecordset
 	auto preparedStmt = m_preparedStmt;
 	m_preparedStmt = nullptr;
 
-	return SqliteRecordset(m_db, preparedStmt, SQLITE_ROW == res);
+	return SqliteRecordset(m_db, m_statementCache, m_busyHandler, preparedStmt, SQLITE_ROW == res, true, deadline);
+}
+
+void
+SqliteCommand::executeBatchRow(const std::optional<SqliteRecordset::TDeadline>& deadline)
+{
+	// Inside batch transaction only read-only rows are retried
+	auto res = SqliteRecordset::step(m_db, m_preparedStmt, deadline, m_busyHandler, true);
+	if (SQLITE_DONE != res)
+	{
+		std::string errMsg = sqlite3_errmsg(m_db);
+		reset();
+
+		SqliteRecordset::throwStepError(res, errMsg);
+	}
+
+	reset();
+}
+
+std::optional<SqliteTransaction>
+SqliteCommand::beginBatch(bool useTransaction)
+{
+	// Nested batch would commit a transaction started by caller
+	if (!useTransaction || 0 == sqlite3_get_autocommit(m_db))
+		return std::nullopt;
+
+	return m_sqliteDb->beginTransaction(SqliteTransaction::Mode::Immediate);
+}
+
+SqliteCommand&
+SqliteCommand::reset()
+{
+	checkStatement();
+
+	sqlite3_reset(m_preparedStmt);
+	m_parameterCount = 0;
+
+	return *this;
+}
+
+SqliteCommand&
+SqliteCommand::rebind()
+{
+	reset();
+	sqlite3_clear_bindings(m_preparedStmt);
+
+	return *this;
+}
+
+bool
+SqliteCommand::isPersistent() const
+{
+	return m_persistent;
+}
+
+SqliteCommand&
+SqliteCommand::withTimeout(std::chrono::milliseconds timeout)
+{
+	m_timeout = timeout;
+	return *this;
+}
+
+std::optional<SqliteRecordset::TDeadline>
+SqliteCommand::getDeadline() const
+{
+	if (!m_timeout.has_value())
+		return std::nullopt;
+
+	return std::chrono::steady_clock::now() + m_timeout.value();
 }
 
 SqliteCommand&
@@ -161,6 +373,23 @@ SqliteCommand::addParameter(const std::wstring& value)
 	return *this;
 }
 
+SqliteCommand&
+SqliteCommand::addParameter(std::string_view value)
+{
+	checkStatement();
+
+	// Empty view may have no data; nullptr would be bound as NULL
+	const char* szValue = value.empty() ? "" : value.data();
+
+	auto res = sqlite3_bind_text64(
+		m_preparedStmt, ++m_parameterCount, szValue, value.size(), SQLITE_TRANSIENT, SQLITE_UTF8);
+
+	if (SQLITE_OK != res)
+		throw SqliteError(sqlite3_errmsg(m_db));
+
+	return *this;
+}
+
 SqliteCommand&
 SqliteCommand::addParameter(const SqliteRecordset::TDateTime& value)
 {
@@ -192,6 +421,18 @@ SqliteCommand::addParameterBlob(const unsigned char* buf, int bufSize)
 	return *this;
 }
 
+SqliteCommand&
+SqliteCommand::addParameterZeroBlob(size_t size)
+{
+	checkStatement();
+
+	auto res = sqlite3_bind_zeroblob64(m_preparedStmt, ++m_parameterCount, size);
+	if (SQLITE_OK != res)
+		throw SqliteError(sqlite3_errmsg(m_db));
+
+	return *this;
+}
+
 SqliteCommand&
 SqliteCommand::addParameterNull()
 {
@@ -203,3 +444,58 @@ SqliteCommand::addParameterNull()
 
 	return *this;
 }
+
+SqliteCommand&
+SqliteCommand::addParameterArray(std::span<const long long> values)
+{
+	checkStatement();
+	return addParameterArray(new SqliteArray(values));
+}
+
+SqliteCommand&
+SqliteCommand::addParameterArray(std::span<const long> values)
+{
+	checkStatement();
+	return addParameterArray(new SqliteArray(values));
+}
+
+SqliteCommand&
+SqliteCommand::addParameterArray(std::span<const int> values)
+{
+	checkStatement();
+	return addParameterArray(new SqliteArray(values));
+}
+
+SqliteCommand&
+SqliteCommand::addParameterArray(std::span<const double> values)
+{
+	checkStatement();
+	return addParameterArray(new SqliteArray(values));
+}
+
+SqliteCommand&
+SqliteCommand::addParameterArray(std::span<const std::string> values)
+{
+	checkStatement();
+	return addParameterArray(new SqliteArray(values));
+}
+
+SqliteCommand&
+SqliteCommand::addParameterArray(std::span<const std::string_view> values)
+{
+	checkStatement();
+	return addParameterArray(new SqliteArray(values));
+}
+
+SqliteCommand&
+SqliteCommand::addParameterArray(SqliteArray* array)
+{
+	// Array is destroyed by SQLite, also on failure
+	auto res = sqlite3_bind_pointer(
+		m_preparedStmt, ++m_parameterCount, array, SqliteArray::POINTER_TYPE, &SqliteArray::destroy);
+
+	if (SQLITE_OK != res)
+		throw SqliteError(sqlite3_errmsg(m_db));
+
+	return *this;
+}
@@ -1,43 +1,70 @@
 #include <filesystem>
 #include <cassert>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <cstring>
 #include "sqlite3.h"
 #include "SqliteDb.h"
+#include "SqliteArray.h"
 #include "SqliteExceptions.h"
 
-SqliteDb::SqliteDb(const std::wstring& dbFileName)
-	: m_db(nullptr),
-    m_dbFileName(dbFileName)
+SqliteDb::SqliteDb(const std::wstring& dbFileName, const SqliteDbOptions& options)
+    : m_dbFilePath(dbFileName),
+    m_options(options),
+    m_db(nullptr),
+    m_statementCache(options.statementCacheCapacity),
+    m_nextTransactionId(0)
 {
-    assert(!m_dbFileName.empty());
+    assert(!m_dbFilePath.empty());
 
     checkCreateDatabaseDirectory();
     open();
 }
 
-SqliteDb::~SqliteDb()
+SqliteDb::SqliteDb(std::string_view dbFileName, const SqliteDbOptions& options)
+    : m_dbFilePath(std::u8string_view(reinterpret_cast<const char8_t*>(dbFileName.data()), dbFileName.size())),
+    m_options(options),
+    m_db(nullptr),
+    m_statementCache(options.statementCacheCapacity),
+    m_nextTransactionId(0)
 {
-    close();
+    assert(!m_dbFilePath.empty());
+
+    checkCreateDatabaseDirectory();
+    open();
 }
 
-std::wstring
-SqliteDb::getDirectoryFromFilePath(const std::wstring& filePath)
+SqliteDb::SqliteDb(std::span<const std::byte> image, bool copyImage, const SqliteDbOptions& options)
+    : m_dbFilePath(":memory:"),
+    m_options(options),
+    m_db(nullptr),
+    m_statementCache(options.statementCacheCapacity),
+    m_nextTransactionId(0)
 {
-    auto slashPos = filePath.find_last_of(L"/\\");
-    if (std::string::npos == slashPos)
-        return L"";
+    m_options.uri = false;
+
+    open(&image, copyImage);
+}
 
-    std::wstring dir = filePath.substr(0, slashPos);
-    return dir;
+SqliteDb::~SqliteDb()
+{
+    close();
 }
 
 void
 SqliteDb::checkCreateDatabaseDirectory()
 {
-    const auto& dbDir = getDirectoryFromFilePath(m_dbFileName);
+    // Nothing to create for read-only DB; URI is not a file path
+    if (m_options.readOnly || m_options.uri)
+        return;
+
+    const auto dbDir = m_dbFilePath.parent_path();
 
     // Create directory for DB file if the dir does not exist
     std::error_code err;
-    if (!std::filesystem::exists(dbDir) &&
+    if (!dbDir.empty() &&
+        !std::filesystem::exists(dbDir) &&
         !std::filesystem::create_directories(dbDir, err))
     {
         throw SqliteError(err.message());
@@ -45,9 +72,25 @@ SqliteDb::checkCreateDatabaseDirectory()
 }
 
 void
-SqliteDb::open()
+SqliteDb::open(const std::span<const std::byte>* image, bool copyImage)
 {
-    int res = sqlite3_open16(m_dbFileName.c_str(), &m_db);
+    // sqlite3_open_v2 accepts UTF-8 file names only
+    const auto dbFileName = m_dbFilePath.u8string();
+
+    // Read-only image is loaded into writable in-memory connection
+    int flags = m_options.readOnly && nullptr == image
+        ? SQLITE_OPEN_READONLY
+        : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
+
+    if (m_options.noMutex)
+        flags |= SQLITE_OPEN_NOMUTEX;
+
+    if (m_options.uri)
+        flags |= SQLITE_OPEN_URI;
+
+    const char* szVfs = m_options.vfs.empty() ? nullptr : m_options.vfs.c_str();
+
+    int res = sqlite3_open_v2(reinterpret_cast<const char*>(dbFileName.c_str()), &m_db, flags, szVfs);
     if (SQLITE_OK != res)
     {
         std::string errorMsg{"Failed to open database"};
@@ -63,21 +106,101 @@ SqliteDb::open()
         throw SqliteError(errorMsg);
     }
 
-    char* szErrMsg = nullptr;
-    res = sqlite3_exec(m_db, "PRAGMA temp_store=MEMORY", NULL, NULL, &szErrMsg);
-    if (SQLITE_OK != res)
+    try
     {
-        assert(0);
-        sqlite3_free(szErrMsg);
+        // PRAGMAs applied before deserialization would be lost
+        if (nullptr != image)
+            deserialize(*image, copyImage);
+
+        SqliteArray::registerModule(m_db);
+        configure();
+
+        // Created disabled, so that snapshots taken by other threads never see the pointer change
+        m_profiler = std::make_unique<SqliteProfiler>(m_db);
+    }
+    catch (...)
+    {
+        sqlite3_close(m_db);
+        m_db = nullptr;
+
+        throw;
+    }
+}
+
+void
+SqliteDb::configure()
+{
+    static const char* const JOURNAL_MODES[] = { "delete", "truncate", "persist", "memory", "wal", "off" };
+    static const char* const SYNCHRONOUS_LEVELS[] = { "off", "normal", "full", "extra" };
+    static const char* const LOCKING_MODES[] = { "normal", "exclusive" };
+    static const char* const TEMP_STORES[] = { "default", "file", "memory" };
+
+    // Set busy policy first so that the following PRAGMAs wait for locks
+    if (m_options.busyPolicy.has_value())
+        m_busyHandler.setPolicy(m_db, m_options.busyPolicy.value());
+    else if (m_options.busyTimeout.has_value())
+    {
+        SqliteBusyPolicy policy;
+        policy.strategy = SqliteBusyPolicy::Strategy::Timeout;
+        policy.timeout = m_options.busyTimeout.value();
+
+        m_busyHandler.setPolicy(m_db, policy);
+    }
+
+    // Page size has to be set before journal mode is switched to WAL
+    if (m_options.pageSize.has_value())
+        executePragma("PRAGMA page_size=" + std::to_string(m_options.pageSize.value()));
+
+    if (m_options.lockingMode.has_value())
+        executePragma(std::string("PRAGMA locking_mode=") + LOCKING_MODES[static_cast<int>(m_options.lockingMode.value())]);
+
+    if (m_options.journalMode.has_value())
+    {
+        const std::string journalMode = JOURNAL_MODES[static_cast<int>(m_options.journalMode.value())];
+
+        // PRAGMA journal_mode returns the resulting mode, which differs from requested one on failure
+        const auto resultMode = executePragma("PRAGMA journal_mode=" + journalMode);
+        if (resultMode != journalMode)
+            throw SqliteError("Failed to set journal mode " + journalMode + ", current mode: " + resultMode);
     }
 
-    szErrMsg = nullptr;
-    res = sqlite3_exec(m_db, "PRAGMA journal_mode=MEMORY", NULL, NULL, &szErrMsg);
+    if (m_options.synchronous.has_value())
+        executePragma(std::string("PRAGMA synchronous=") + SYNCHRONOUS_LEVELS[static_cast<int>(m_options.synchronous.value())]);
+
+    if (m_options.cacheSize.has_value())
+        executePragma("PRAGMA cache_size=" + std::to_string(m_options.cacheSize.value()));
+
+    if (m_options.mmapSize.has_value())
+        executePragma("PRAGMA mmap_size=" + std::to_string(m_options.mmapSize.value()));
+
+    if (m_options.tempStore.has_value())
+        executePragma(std::string("PRAGMA temp_store=") + TEMP_STORES[static_cast<int>(m_options.tempStore.value())]);
+}
+
+std::string
+SqliteDb::executePragma(const std::string& pragma)
+{
+    std::string result;
+
+    auto callback = [](void* arg, int columnCount, char** values, char**) -> int {
+        if (columnCount > 0 && nullptr != values[0])
+            *static_cast<std::string*>(arg) = values[0];
+
+        return SQLITE_OK;
+    };
+
+    char* szErrMsg = nullptr;
+    int res = sqlite3_exec(m_db, pragma.c_str(), callback, &result, &szErrMsg);
     if (SQLITE_OK != res)
     {
-        assert(0);
+        std::string errorMsg = "Failed to execute " + pragma + ", error: ";
+        errorMsg += nullptr != szErrMsg ? szErrMsg : sqlite3_errstr(res);
         sqlite3_free(szErrMsg);
+
+        throw SqliteError(errorMsg);
     }
+
+    return result;
 }
 
 void
@@ -85,6 +208,15 @@ SqliteDb::close()
 {
     if (nullptr != m_db)
     {
+        // Cached statements must be finalized before closing DB
+        m_statementCache.clear();
+
+        for (auto stmt : m_fixedStatements)
+            sqlite3_finalize(stmt);
+
+        m_fixedStatements.clear();
+        m_profiler.reset();
+
         sqlite3_close(m_db);
         m_db = nullptr;
     }
@@ -97,6 +229,13 @@ SqliteDb::execute(const std::wstring& sql)
         .execute();
 }
 
+void
+SqliteDb::execute(std::string_view sql)
+{
+    prepare(sql)
+        .execute();
+}
+
 SqliteRecordset
 SqliteDb::select(const std::wstring& sql)
 {
@@ -104,6 +243,13 @@ SqliteDb::select(const std::wstring& sql)
         .select();
 }
 
+SqliteRecordset
+SqliteDb::select(std::string_view sql)
+{
+    return prepare(sql)
+        .select();
+}
+
 SqliteCommand
 SqliteDb::prepare(const std::wstring& sql)
 {
@@ -113,11 +259,338 @@ SqliteDb::prepare(const std::wstring& sql)
             return !std::isspace(ch) && ch != L';';
         }).base(), sql2.end());
 
-    return SqliteCommand(m_db, sql2);
+    return SqliteCommand(this, m_db, &m_statementCache, &m_busyHandler, sql2);
+}
+
+SqliteCommand
+SqliteDb::prepare(std::string_view sql)
+{
+    // RTrim without copying
+    while (!sql.empty() &&
+        (std::isspace(static_cast<unsigned char>(sql.back())) || ';' == sql.back()))
+    {
+        sql.remove_suffix(1);
+    }
+
+    return SqliteCommand(this, m_db, &m_statementCache, &m_busyHandler, sql);
+}
+
+SqliteCommand
+SqliteDb::preparePersistent(const std::wstring& sql)
+{
+    auto cmd = prepare(sql);
+    cmd.m_persistent = true;
+
+    return cmd;
+}
+
+SqliteCommand
+SqliteDb::preparePersistent(std::string_view sql)
+{
+    auto cmd = prepare(sql);
+    cmd.m_persistent = true;
+
+    return cmd;
+}
+
+size_t
+SqliteDb::allocateStatementSlot()
+{
+    static std::atomic<size_t> nextSlot{ 0 };
+    return nextSlot++;
+}
+
+SqliteCommand
+SqliteDb::prepareStatement(size_t slot, std::string_view sql)
+{
+    if (slot >= m_fixedStatements.size())
+        m_fixedStatements.resize(slot + 1, nullptr);
+
+    auto& stmt = m_fixedStatements[slot];
+    if (nullptr == stmt)
+    {
+        const char* pTail = nullptr;
+        int res = sqlite3_prepare_v3(m_db, sql.data(), static_cast<int>(sql.size()), SQLITE_PREPARE_PERSISTENT, &stmt, &pTail);
+        if (SQLITE_OK != res)
+        {
+            std::string errMsg = sqlite3_errmsg(m_db);
+            sqlite3_finalize(stmt);
+            stmt = nullptr;
+
+            throw SqliteError(errMsg);
+        }
+
+        // Check that no statements left unprocessed
+        if (nullptr != pTail && sql.data() + sql.size() != pTail)
+        {
+            sqlite3_finalize(stmt);
+            stmt = nullptr;
+
+            throw MultipleStatementsUnsupportedError();
+        }
+    }
+
+    return SqliteCommand(this, m_db, &m_busyHandler, stmt);
+}
+
+void
+SqliteDb::registerFunction(std::string_view name, int argCount, bool deterministic,
+    void* userData, SqliteFunction::TCallback callback, SqliteFunction::TDestroy destroy)
+{
+    int flags = SQLITE_UTF8;
+    if (deterministic)
+        flags |= SQLITE_DETERMINISTIC;
+
+    int res = sqlite3_create_function_v2(m_db, std::string(name).c_str(), argCount, flags,
+        userData, callback, nullptr, nullptr, destroy);
+
+    if (SQLITE_OK != res)
+        throw SqliteError(sqlite3_errmsg(m_db));
+}
+
+void
+SqliteDb::registerAggregate(std::string_view name, int argCount, bool deterministic,
+    SqliteFunction::TCallback step, SqliteFunction::TFinalCallback final,
+    SqliteFunction::TFinalCallback value, SqliteFunction::TCallback inverse)
+{
+    int flags = SQLITE_UTF8;
+    if (deterministic)
+        flags |= SQLITE_DETERMINISTIC;
+
+    int res = sqlite3_create_window_function(m_db, std::string(name).c_str(), argCount, flags,
+        nullptr, step, final, value, inverse, nullptr);
+
+    if (SQLITE_OK != res)
+        throw SqliteError(sqlite3_errmsg(m_db));
 }
 
 SqliteTransaction
-SqliteDb::beginTransaction()
+SqliteDb::beginTransaction(SqliteTransaction::Mode mode)
+{
+    return SqliteTransaction(this, mode);
+}
+
+bool
+SqliteDb::waitTransactionRetry(int attempt, const SqliteRetryPolicy& retryPolicy)
+{
+    // Locks of nested transaction are held by enclosing one until it is complete
+    if (!m_activeTransactions.empty() || 0 == sqlite3_get_autocommit(m_db))
+        return false;
+
+    return m_busyHandler.wait(attempt, retryPolicy);
+}
+
+void
+SqliteDb::interrupt()
+{
+    sqlite3_interrupt(m_db);
+}
+
+void
+SqliteDb::backupTo(SqliteDb& target, int pagesPerStep, TBackupProgress progress, std::chrono::milliseconds stepPause)
+{
+    backup(m_db, target.m_db, pagesPerStep, progress, stepPause);
+}
+
+void
+SqliteDb::backupTo(const std::wstring& targetFileName, int pagesPerStep, TBackupProgress progress, std::chrono::milliseconds stepPause)
+{
+    SqliteDb target(targetFileName);
+    backupTo(target, pagesPerStep, progress, stepPause);
+}
+
+void
+SqliteDb::backupTo(std::string_view targetFileName, int pagesPerStep, TBackupProgress progress, std::chrono::milliseconds stepPause)
+{
+    SqliteDb target(targetFileName);
+    backupTo(target, pagesPerStep, progress, stepPause);
+}
+
+void
+SqliteDb::restoreFrom(SqliteDb& source, int pagesPerStep, TBackupProgress progress)
+{
+    // Nobody else is expected to wait for this database while it is being loaded
+    backup(source.m_db, m_db, pagesPerStep, progress, std::chrono::milliseconds(0));
+}
+
+void
+SqliteDb::restoreFrom(const std::wstring& sourceFileName, int pagesPerStep, TBackupProgress progress)
+{
+    SqliteDbOptions options;
+    options.readOnly = true;
+    options.journalMode.reset();
+
+    SqliteDb source(sourceFileName, options);
+    restoreFrom(source, pagesPerStep, progress);
+}
+
+void
+SqliteDb::restoreFrom(std::string_view sourceFileName, int pagesPerStep, TBackupProgress progress)
+{
+    SqliteDbOptions options;
+    options.readOnly = true;
+    options.journalMode.reset();
+
+    SqliteDb source(sourceFileName, options);
+    restoreFrom(source, pagesPerStep, progress);
+}
+
+void
+SqliteDb::backup(sqlite3* source, sqlite3* target, int pagesPerStep,
+    const TBackupProgress& progress, std::chrono::milliseconds stepPause)
+{
+    assert(source != target);
+
+    auto backup = sqlite3_backup_init(target, "main", source, "main");
+    if (nullptr == backup)
+        throw SqliteError(sqlite3_errmsg(target));
+
+    int res = SQLITE_OK;
+
+    try
+    {
+        for (;;)
+        {
+            res = sqlite3_backup_step(backup, pagesPerStep);
+
+            if (SQLITE_OK != res && SQLITE_DONE != res && SQLITE_BUSY != res && SQLITE_LOCKED != res)
+                break;
+
+            if (progress)
+                progress(sqlite3_backup_remaining(backup), sqlite3_backup_pagecount(backup));
+
+            if (SQLITE_DONE == res)
+                break;
+
+            // Let other connections use the source between steps
+            if (stepPause.count() > 0 || SQLITE_BUSY == res || SQLITE_LOCKED == res)
+                std::this_thread::sleep_for(std::max(stepPause, std::chrono::milliseconds(1)));
+            else
+                std::this_thread::yield();
+        }
+    }
+    catch (...)
+    {
+        sqlite3_backup_finish(backup);
+        throw;
+    }
+
+    // Error of backup step is also returned by sqlite3_backup_finish
+    res = sqlite3_backup_finish(backup);
+    if (SQLITE_OK != res)
+        throw SqliteError(sqlite3_errmsg(target));
+}
+
+std::vector<std::byte>
+SqliteDb::serialize() const
+{
+    sqlite3_int64 size = 0;
+    auto buf = sqlite3_serialize(m_db, "main", &size, 0);
+
+    // Empty database has no pages
+    if (nullptr == buf)
+    {
+        if (SQLITE_NOMEM == sqlite3_errcode(m_db))
+            throw SqliteError(sqlite3_errmsg(m_db));
+
+        return std::vector<std::byte>();
+    }
+
+    auto bytes = reinterpret_cast<const std::byte*>(buf);
+    std::vector<std::byte> image(bytes, bytes + size);
+    sqlite3_free(buf);
+
+    return image;
+}
+
+void
+SqliteDb::deserialize(std::span<const std::byte> image, bool copyImage)
+{
+    unsigned char* buf = nullptr;
+    unsigned int flags = 0;
+
+    if (copyImage)
+    {
+        // Copy is owned and resized by SQLite
+        buf = static_cast<unsigned char*>(sqlite3_malloc64(image.size()));
+        if (nullptr == buf && !image.empty())
+            throw SqliteError("Failed to allocate database image");
+
+        if (!image.empty())
+            std::memcpy(buf, image.data(), image.size());
+
+        flags = SQLITE_DESERIALIZE_FREEONCLOSE | SQLITE_DESERIALIZE_RESIZEABLE;
+    }
+    else
+    {
+        // SQLite does not write into read-only image
+        buf = reinterpret_cast<unsigned char*>(const_cast<std::byte*>(image.data()));
+        flags = SQLITE_DESERIALIZE_READONLY;
+    }
+
+    if (m_options.readOnly)
+        flags |= SQLITE_DESERIALIZE_READONLY;
+
+    // Buffer is freed by SQLite on failure if SQLITE_DESERIALIZE_FREEONCLOSE is set
+    int res = sqlite3_deserialize(m_db, "main", buf, image.size(), image.size(), flags);
+    if (SQLITE_OK != res)
+        throw SqliteError(sqlite3_errmsg(m_db));
+}
+
+SqliteBlobStream
+SqliteDb::openBlob(std::string_view table, std::string_view column, long long rowid,
+    bool writable, std::string_view database)
+{
+    return SqliteBlobStream(m_db, std::string(database).c_str(), std::string(table).c_str(),
+        std::string(column).c_str(), rowid, writable);
+}
+
+void
+SqliteDb::setStatementCacheCapacity(size_t capacity)
+{
+    m_options.statementCacheCapacity = capacity;
+    m_statementCache.setCapacity(capacity);
+}
+
+void
+SqliteDb::setBusyPolicy(const SqliteBusyPolicy& policy)
+{
+    m_busyHandler.setPolicy(m_db, policy);
+    m_options.busyPolicy = policy;
+}
+
+SqliteBusyHandler::Stats
+SqliteDb::getBusyStats() const
+{
+    return m_busyHandler.getStats();
+}
+
+const SqliteStatementCache::Stats&
+SqliteDb::getStatementCacheStats() const
+{
+    return m_statementCache.getStats();
+}
+
+const SqliteDbOptions&
+SqliteDb::getOptions() const
+{
+    return m_options;
+}
+
+void
+SqliteDb::setProfilingEnabled(bool enabled)
+{
+    m_profiler->setEnabled(enabled);
+}
+
+std::vector<SqliteStatementProfile>
+SqliteDb::getProfileSnapshot() const
+{
+    return m_profiler->getSnapshot();
+}
+
+void
+SqliteDb::resetProfile()
 {
-    return SqliteTransaction(this);
+    m_profiler->reset();
 }
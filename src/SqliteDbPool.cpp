@@ -0,0 +1,174 @@
+#include <cassert>
+#include "SqliteDbPool.h"
+#include "SqliteExceptions.h"
+
+SqliteDbPool::Lease::Lease(SqliteDbPool* pool, WaitQueue* queue, SqliteDb* db)
+	: m_pool(pool),
+	  m_queue(queue),
+	  m_db(db)
+{
+	assert(m_pool);
+	assert(m_queue);
+	assert(m_db);
+}
+
+SqliteDbPool::Lease::~Lease()
+{
+	release();
+}
+
+SqliteDbPool::Lease::Lease(Lease&& rhs) noexcept
+	: m_pool(rhs.m_pool),
+	  m_queue(rhs.m_queue),
+	  m_db(rhs.m_db)
+{
+	rhs.m_pool = nullptr;
+	rhs.m_queue = nullptr;
+	rhs.m_db = nullptr;
+}
+
+SqliteDbPool::Lease&
+SqliteDbPool::Lease::operator=(Lease&& rhs) noexcept
+{
+	if (this != &rhs)
+	{
+		release();
+
+		m_pool = rhs.m_pool;
+		rhs.m_pool = nullptr;
+
+		m_queue = rhs.m_queue;
+		rhs.m_queue = nullptr;
+
+		m_db = rhs.m_db;
+		rhs.m_db = nullptr;
+	}
+
+	return *this;
+}
+
+SqliteDb&
+SqliteDbPool::Lease::operator*() const
+{
+	assert(m_db);
+	return *m_db;
+}
+
+SqliteDb*
+SqliteDbPool::Lease::operator->() const
+{
+	assert(m_db);
+	return m_db;
+}
+
+void
+SqliteDbPool::Lease::release()
+{
+	if (nullptr != m_db)
+	{
+		m_pool->release(*m_queue, m_db);
+
+		m_pool = nullptr;
+		m_queue = nullptr;
+		m_db = nullptr;
+	}
+}
+
+SqliteDbPool::SqliteDbPool(const std::wstring& dbFileName, size_t readerCount, const SqliteDbOptions& options)
+{
+	open(dbFileName, readerCount, options);
+}
+
+SqliteDbPool::SqliteDbPool(std::string_view dbFileName, size_t readerCount, const SqliteDbOptions& options)
+{
+	open(dbFileName, readerCount, options);
+}
+
+SqliteDbPool::~SqliteDbPool()
+{
+	// Readers are closed first, so that the writer performs final WAL checkpoint
+	m_readers.clear();
+	m_writer.reset();
+}
+
+template <class TFileName>
+void
+SqliteDbPool::open(const TFileName& dbFileName, size_t readerCount, const SqliteDbOptions& options)
+{
+	// acquireReader() would wait forever
+	if (0 == readerCount)
+		throw SqliteError("Pool must have at least one reader connection");
+
+	// Connections are never used by several threads at once
+	SqliteDbOptions writerOptions = options;
+	writerOptions.journalMode = SqliteDbOptions::JournalMode::Wal;
+	writerOptions.readOnly = false;
+	writerOptions.noMutex = true;
+
+	m_writer = std::make_unique<SqliteDb>(dbFileName, writerOptions);
+	m_writerQueue.freeConnections.push_back(m_writer.get());
+
+	// Journal mode is persistent and cannot be changed by read-only connection
+	SqliteDbOptions readerOptions = options;
+	readerOptions.journalMode.reset();
+	readerOptions.readOnly = true;
+	readerOptions.noMutex = true;
+
+	for (size_t i = 0; i < readerCount; ++i)
+	{
+		m_readers.push_back(std::make_unique<SqliteDb>(dbFileName, readerOptions));
+		m_readerQueue.freeConnections.push_back(m_readers.back().get());
+	}
+}
+
+SqliteDbPool::Lease
+SqliteDbPool::acquireWriter()
+{
+	return acquire(m_writerQueue);
+}
+
+SqliteDbPool::Lease
+SqliteDbPool::acquireReader()
+{
+	return acquire(m_readerQueue);
+}
+
+size_t
+SqliteDbPool::getReaderCount() const
+{
+	return m_readers.size();
+}
+
+SqliteDbPool::Lease
+SqliteDbPool::acquire(WaitQueue& queue)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	// Wait for own turn and a free connection
+	const auto ticket = queue.nextTicket++;
+	queue.condition.wait(lock, [&queue, ticket]() {
+		return ticket == queue.servedTicket && !queue.freeConnections.empty();
+	});
+
+	++queue.servedTicket;
+
+	auto db = queue.freeConnections.back();
+	queue.freeConnections.pop_back();
+
+	// Next waiter might get another free connection
+	if (!queue.freeConnections.empty())
+		queue.condition.notify_all();
+
+	return Lease(this, &queue, db);
+}
+
+void
+SqliteDbPool::release(WaitQueue& queue, SqliteDb* db)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		queue.freeConnections.push_back(db);
+	}
+
+	queue.condition.notify_all();
+}
@@ -0,0 +1,127 @@
+#include <stdexcept>
+#include "sqlite3.h"
+#include "SqliteFunction.h"
+#include "SqliteExceptions.h"
+
+void*
+SqliteFunction::getUserData(sqlite3_context* context)
+{
+	return sqlite3_user_data(context);
+}
+
+void*
+SqliteFunction::getAggregateContext(sqlite3_context* context, size_t size)
+{
+	return sqlite3_aggregate_context(context, static_cast<int>(size));
+}
+
+void
+SqliteFunction::setError(sqlite3_context* context, std::exception_ptr error)
+{
+	try
+	{
+		std::rethrow_exception(error);
+	}
+	catch (const std::bad_alloc&)
+	{
+		sqlite3_result_error_nomem(context);
+	}
+	catch (const SqliteInvalidTypeError&)
+	{
+		sqlite3_result_error(context, "Invalid argument type", -1);
+	}
+	catch (const std::exception& e)
+	{
+		sqlite3_result_error(context, e.what(), -1);
+	}
+	catch (...)
+	{
+		sqlite3_result_error(context, "Exception in user-defined function", -1);
+	}
+}
+
+bool
+SqliteFunction::isNull(sqlite3_value* value)
+{
+	return SQLITE_NULL == sqlite3_value_type(value);
+}
+
+long long
+SqliteFunction::getInt64(sqlite3_value* value)
+{
+	// Text would be parsed as a number prefix, giving 0 for non-numeric text
+	const auto type = sqlite3_value_type(value);
+	if (SQLITE_INTEGER != type && SQLITE_FLOAT != type)
+		throw SqliteInvalidTypeError();
+
+	return sqlite3_value_int64(value);
+}
+
+double
+SqliteFunction::getDouble(sqlite3_value* value)
+{
+	const auto type = sqlite3_value_type(value);
+	if (SQLITE_INTEGER != type && SQLITE_FLOAT != type)
+		throw SqliteInvalidTypeError();
+
+	return sqlite3_value_double(value);
+}
+
+std::string_view
+SqliteFunction::getText(sqlite3_value* value)
+{
+	// sqlite3_value_bytes must be called after sqlite3_value_text
+	auto szValue = sqlite3_value_text(value);
+	auto size = sqlite3_value_bytes(value);
+
+	if (nullptr == szValue)
+		return std::string_view();
+
+	return std::string_view(reinterpret_cast<const char*>(szValue), size);
+}
+
+std::span<const std::byte>
+SqliteFunction::getBlob(sqlite3_value* value)
+{
+	auto buf = reinterpret_cast<const std::byte*>(sqlite3_value_blob(value));
+	auto bufSize = sqlite3_value_bytes(value);
+
+	return std::span<const std::byte>(buf, bufSize);
+}
+
+void
+SqliteFunction::setResultNull(sqlite3_context* context)
+{
+	sqlite3_result_null(context);
+}
+
+void
+SqliteFunction::setResultInt64(sqlite3_context* context, long long value)
+{
+	sqlite3_result_int64(context, value);
+}
+
+void
+SqliteFunction::setResultDouble(sqlite3_context* context, double value)
+{
+	sqlite3_result_double(context, value);
+}
+
+void
+SqliteFunction::setResultText(sqlite3_context* context, std::string_view value)
+{
+	// Empty view may have no data; nullptr would be returned as NULL
+	const char* szValue = value.empty() ? "" : value.data();
+
+	sqlite3_result_text64(context, szValue, value.size(), SQLITE_TRANSIENT, SQLITE_UTF8);
+}
+
+void
+SqliteFunction::setResultBlob(sqlite3_context* context, std::span<const std::byte> value)
+{
+	// Empty span may have no data; nullptr would be returned as NULL
+	if (value.empty())
+		sqlite3_result_zeroblob(context, 0);
+	else
+		sqlite3_result_blob64(context, value.data(), value.size(), SQLITE_TRANSIENT);
+}
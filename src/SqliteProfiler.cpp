@@ -0,0 +1,229 @@
+#include <cassert>
+#include <cctype>
+#include <algorithm>
+#include "sqlite3.h"
+#include "SqliteProfiler.h"
+
+SqliteProfiler::SqliteProfiler(sqlite3* db)
+	: m_db(db),
+	  m_enabled(false)
+{
+	assert(m_db);
+}
+
+SqliteProfiler::~SqliteProfiler()
+{
+	setEnabled(false);
+}
+
+void
+SqliteProfiler::setEnabled(bool enabled)
+{
+	if (enabled == m_enabled)
+		return;
+
+	if (enabled)
+		sqlite3_trace_v2(m_db, SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW, &SqliteProfiler::traceCallback, this);
+	else
+		sqlite3_trace_v2(m_db, 0, nullptr, nullptr);
+
+	m_enabled = enabled;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_pendingRowCounts.clear();
+}
+
+bool
+SqliteProfiler::isEnabled() const
+{
+	return m_enabled;
+}
+
+std::vector<SqliteStatementProfile>
+SqliteProfiler::getSnapshot() const
+{
+	std::vector<SqliteStatementProfile> snapshot;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	snapshot.reserve(m_entries.size());
+
+	std::vector<std::chrono::nanoseconds> latencies;
+	for (const auto& [sql, entry] : m_entries)
+	{
+		snapshot.push_back(entry.profile);
+
+		// Percentiles of recent latencies
+		latencies = entry.latencies;
+		std::sort(latencies.begin(), latencies.end());
+
+		if (!latencies.empty())
+		{
+			snapshot.back().p50Time = latencies[(latencies.size() - 1) * 50 / 100];
+			snapshot.back().p99Time = latencies[(latencies.size() - 1) * 99 / 100];
+		}
+	}
+
+	return snapshot;
+}
+
+void
+SqliteProfiler::reset()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_entries.clear();
+	m_normalizedSql.clear();
+	m_pendingRowCounts.clear();
+}
+
+std::string
+SqliteProfiler::normalizeSql(std::string_view sql)
+{
+	std::string normalized;
+	normalized.reserve(sql.size());
+
+	auto isIdentifierChar = [](char ch) {
+		return std::isalnum(static_cast<unsigned char>(ch)) || '_' == ch || '$' == ch;
+	};
+
+	for (size_t i = 0; i < sql.size(); )
+	{
+		const char ch = sql[i];
+
+		if (std::isspace(static_cast<unsigned char>(ch)))
+		{
+			// Collapse whitespace
+			while (i < sql.size() && std::isspace(static_cast<unsigned char>(sql[i])))
+				++i;
+
+			if (!normalized.empty() && i < sql.size())
+				normalized += ' ';
+		}
+		else if ('\'' == ch)
+		{
+			// String literal; '' is an escaped quote
+			for (++i; i < sql.size(); ++i)
+			{
+				if ('\'' == sql[i])
+				{
+					if (i + 1 < sql.size() && '\'' == sql[i + 1])
+						++i;
+					else
+						break;
+				}
+			}
+
+			++i;
+			normalized += '?';
+		}
+		else if (std::isdigit(static_cast<unsigned char>(ch)) &&
+			(normalized.empty() || !isIdentifierChar(normalized.back())))
+		{
+			// Numeric literal
+			while (i < sql.size() && (isIdentifierChar(sql[i]) || '.' == sql[i]))
+				++i;
+
+			normalized += '?';
+		}
+		else if (isIdentifierChar(ch) || '"' == ch)
+		{
+			// Identifiers and keywords are kept as is
+			const char quote = '"' == ch ? '"' : '\0';
+			normalized += sql[i++];
+
+			while (i < sql.size() && (quote ? quote != sql[i] : isIdentifierChar(sql[i])))
+				normalized += sql[i++];
+
+			if (quote && i < sql.size())
+				normalized += sql[i++];
+		}
+		else
+			normalized += sql[i++];
+	}
+
+	return normalized;
+}
+
+int
+SqliteProfiler::traceCallback(unsigned int type, void* context, void* p, void* x)
+{
+	auto profiler = static_cast<SqliteProfiler*>(context);
+	auto stmt = static_cast<sqlite3_stmt*>(p);
+
+	if (SQLITE_TRACE_ROW == type)
+		profiler->onRow(stmt);
+	else if (SQLITE_TRACE_PROFILE == type)
+		profiler->onProfile(stmt, *static_cast<sqlite3_int64*>(x));
+
+	return 0;
+}
+
+void
+SqliteProfiler::onRow(sqlite3_stmt* stmt)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	++m_pendingRowCounts[stmt];
+}
+
+void
+SqliteProfiler::onProfile(sqlite3_stmt* stmt, long long nanoseconds)
+{
+	// Counters are reset so that the next execution reports its own values
+	const auto fullscanSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+	const auto sortCount = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+	const auto autoindexCount = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+	const auto vmSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+
+	const char* szSql = sqlite3_sql(stmt);
+	const std::string_view sql = nullptr != szSql ? szSql : "";
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto itNormalized = m_normalizedSql.find(sql);
+	if (m_normalizedSql.end() == itNormalized)
+	{
+		if (m_normalizedSql.size() >= NORMALIZED_SQL_CACHE_SIZE)
+			m_normalizedSql.clear();
+
+		itNormalized = m_normalizedSql.emplace(std::string(sql), normalizeSql(sql)).first;
+	}
+
+	auto& entry = m_entries[itNormalized->second];
+	auto& profile = entry.profile;
+
+	const std::chrono::nanoseconds time(nanoseconds);
+
+	if (0 == profile.callCount)
+	{
+		profile.sql = itNormalized->second;
+		profile.minTime = time;
+		profile.maxTime = time;
+	}
+	else
+	{
+		profile.minTime = std::min(profile.minTime, time);
+		profile.maxTime = std::max(profile.maxTime, time);
+	}
+
+	++profile.callCount;
+	profile.totalTime += time;
+
+	profile.fullscanSteps += fullscanSteps;
+	profile.sortCount += sortCount;
+	profile.autoindexCount += autoindexCount;
+	profile.vmSteps += vmSteps;
+
+	auto itRows = m_pendingRowCounts.find(stmt);
+	if (m_pendingRowCounts.end() != itRows)
+	{
+		profile.rowCount += itRows->second;
+		m_pendingRowCounts.erase(itRows);
+	}
+
+	if (entry.latencies.size() < LATENCY_SAMPLE_COUNT)
+		entry.latencies.push_back(time);
+	else
+		entry.latencies[entry.nextLatency] = time;
+
+	entry.nextLatency = (entry.nextLatency + 1) % LATENCY_SAMPLE_COUNT;
+}
@@ -2,12 +2,19 @@
 #include <algorithm>
 #include "sqlite3.h"
 #include "SqliteRecordset.h"
+#include "SqliteStatementCache.h"
+#include "SqliteBusyHandler.h"
 #include "SqliteExceptions.h"
 
-SqliteRecordset::SqliteRecordset(sqlite3* db, sqlite3_stmt* preparedStmt, bool valid)
+SqliteRecordset::SqliteRecordset(sqlite3* db, SqliteStatementCache* statementCache, SqliteBusyHandler* busyHandler,
+	sqlite3_stmt* preparedStmt, bool valid, bool ownsStatement, const std::optional<TDeadline>& deadline)
 	: m_db(db),
+	  m_statementCache(statementCache),
+	  m_busyHandler(busyHandler),
 	  m_preparedStmt(preparedStmt),
-	  m_valid(valid)
+	  m_valid(valid),
+	  m_ownsStatement(ownsStatement),
+	  m_deadline(deadline)
 {
 }
 
@@ -15,7 +22,12 @@ SqliteRecordset::~SqliteRecordset()
 {
 	if (m_preparedStmt)
 	{
-		sqlite3_finalize(m_preparedStmt);
+		// Statement shared with persistent command is rewound for its next execution
+		sqlite3_reset(m_preparedStmt);
+
+		if (m_ownsStatement)
+			m_statementCache->release(m_preparedStmt);
+
 		m_preparedStmt = nullptr;
 	}
 }
@@ -28,15 +40,85 @@ SqliteRecordset::operator bool() const
 SqliteRecordset&
 SqliteRecordset::operator++()
 {
-	auto res = sqlite3_step(m_preparedStmt);
-	assert(SQLITE_BUSY != res && SQLITE_LOCKED != res && "SQLITE_BUSY, SQLITE_LOCKED are not handled since concurent access is not supported");
-	assert(SQLITE_ROW == res || SQLITE_DONE == res);
+	// Rows already read would be repeated by retry
+	auto res = step(m_db, m_preparedStmt, m_deadline, m_busyHandler, false);
 
 	m_valid = SQLITE_ROW == res;
 
+	if (SQLITE_ROW != res && SQLITE_DONE != res)
+		throwStepError(res, sqlite3_errmsg(m_db));
+
 	return *this;
 }
 
+int
+SqliteRecordset::step(sqlite3* db, sqlite3_stmt* stmt, const std::optional<TDeadline>& deadline,
+	SqliteBusyHandler* busyHandler, bool retryBusy)
+{
+	auto progressHandler = [](void* arg) -> int {
+		// Non-zero result interrupts the statement
+		return std::chrono::steady_clock::now() >= *static_cast<const TDeadline*>(arg) ? 1 : 0;
+	};
+
+	auto stepOnce = [db, stmt, &deadline, &progressHandler]() {
+		if (!deadline.has_value())
+			return sqlite3_step(stmt);
+
+		// Handler is installed only for the step since it is shared by all statements of the connection
+		sqlite3_progress_handler(db, DEADLINE_CHECK_INSTRUCTIONS, progressHandler, const_cast<TDeadline*>(&deadline.value()));
+		auto res = sqlite3_step(stmt);
+		sqlite3_progress_handler(db, 0, nullptr, nullptr);
+
+		return res;
+	};
+
+	if (nullptr == busyHandler)
+		return stepOnce();
+
+	const auto busyCount = busyHandler->getBusyCount();
+
+	auto res = stepOnce();
+	if (SQLITE_BUSY != (res & 0xff))
+		return res;
+
+	// Lock has already been waited for by busy handler if it was called
+	if (busyHandler->getBusyCount() == busyCount)
+	{
+		busyHandler->onBusy();
+
+		// SQLite does not wait for a lock if waiting could deadlock or WAL snapshot is stale
+		if (retryBusy && (0 != sqlite3_get_autocommit(db) || 0 != sqlite3_stmt_readonly(stmt)))
+		{
+			const auto start = std::chrono::steady_clock::now();
+
+			for (int attempt = 0; SQLITE_BUSY == (res & 0xff) && busyHandler->wait(attempt, start); ++attempt)
+			{
+				sqlite3_reset(stmt);
+				busyHandler->onRetry();
+
+				res = stepOnce();
+			}
+		}
+	}
+
+	if (SQLITE_BUSY == (res & 0xff))
+		busyHandler->onFailure();
+
+	return res;
+}
+
+void
+SqliteRecordset::throwStepError(int res, const std::string& errMsg)
+{
+	if (SQLITE_INTERRUPT == (res & 0xff))
+		throw SqliteInterruptedError(errMsg);
+
+	if (SQLITE_BUSY == (res & 0xff))
+		throw SqliteBusyError(errMsg);
+
+	throw SqliteError(errMsg);
+}
+
 bool
 SqliteRecordset::isNull(int index) const
 {
@@ -89,6 +171,39 @@ SqliteRecordset::getWString(int index) const
 	return value;
 }
 
+std::optional<std::string>
+SqliteRecordset::getString(int index) const
+{
+	const auto type = sqlite3_column_type(m_preparedStmt, index);
+
+	if (SQLITE_NULL == type)
+		return std::optional<std::string>();
+	else if (SQLITE_TEXT != type)
+		throw SqliteInvalidTypeError();
+
+	auto szValue = sqlite3_column_text(m_preparedStmt, index);
+	auto size = sqlite3_column_bytes(m_preparedStmt, index);
+	std::string value(reinterpret_cast<const char*>(szValue), size);
+
+	return value;
+}
+
+std::optional<std::string_view>
+SqliteRecordset::getTextView(int index) const
+{
+	const auto type = sqlite3_column_type(m_preparedStmt, index);
+
+	if (SQLITE_NULL == type)
+		return std::optional<std::string_view>();
+	else if (SQLITE_TEXT != type)
+		throw SqliteInvalidTypeError();
+
+	auto szValue = sqlite3_column_text(m_preparedStmt, index);
+	auto size = sqlite3_column_bytes(m_preparedStmt, index);
+
+	return std::string_view(reinterpret_cast<const char*>(szValue), size);
+}
+
 std::optional<double>
 SqliteRecordset::getDouble(int index) const
 {
@@ -145,3 +260,131 @@ SqliteRecordset::getBlob(int index) const
 
 	return value;
 }
+
+std::optional<std::span<const std::byte>>
+SqliteRecordset::getBlobView(int index) const
+{
+	const auto type = sqlite3_column_type(m_preparedStmt, index);
+
+	if (SQLITE_NULL == type)
+		return std::optional<std::span<const std::byte>>();
+	else if (SQLITE_BLOB != type)
+		throw SqliteInvalidTypeError();
+
+	// Zero-length blob has no buffer
+	auto buf = reinterpret_cast<const std::byte*>(sqlite3_column_blob(m_preparedStmt, index));
+	auto bufSize = sqlite3_column_bytes(m_preparedStmt, index);
+
+	return std::span<const std::byte>(buf, bufSize);
+}
+
+size_t
+SqliteRecordset::fetchBatch(SqliteColumnBatch& batch, size_t maxRows)
+{
+	batch.clear();
+
+	if (!m_valid)
+		return 0;
+
+	if (static_cast<int>(batch.getColumnCount()) > sqlite3_column_count(m_preparedStmt))
+		throw SqliteError("Batch column count exceeds recordset column count");
+
+	batch.reserve(maxRows);
+
+	const int columnCount = static_cast<int>(batch.getColumnCount());
+	size_t row = 0;
+
+	for (; m_valid && row < maxRows; ++row, ++(*this))
+	{
+		for (int index = 0; index < columnCount; ++index)
+		{
+			auto& column = batch.m_columns[index];
+
+			const auto type = sqlite3_column_type(m_preparedStmt, index);
+			const bool isNull = SQLITE_NULL == type;
+
+			switch (column.type)
+			{
+			case SqliteColumnBatch::ColumnType::Int64:
+				if (!isNull && SQLITE_INTEGER != type)
+					throw SqliteInvalidTypeError();
+
+				column.int64Values.push_back(isNull ? 0 : sqlite3_column_int64(m_preparedStmt, index));
+				break;
+
+			case SqliteColumnBatch::ColumnType::Double:
+				if (!isNull && SQLITE_FLOAT != type)
+					throw SqliteInvalidTypeError();
+
+				column.doubleValues.push_back(isNull ? 0.0 : sqlite3_column_double(m_preparedStmt, index));
+				break;
+
+			case SqliteColumnBatch::ColumnType::Text:
+				if (!isNull && SQLITE_TEXT != type)
+					throw SqliteInvalidTypeError();
+
+				if (!isNull)
+				{
+					auto szValue = sqlite3_column_text(m_preparedStmt, index);
+					auto size = sqlite3_column_bytes(m_preparedStmt, index);
+					column.textArena.append(reinterpret_cast<const char*>(szValue), size);
+				}
+
+				column.textOffsets.push_back(column.textArena.size());
+				break;
+			}
+
+			if (0 == row % 64)
+				column.nullBitmap.push_back(0);
+
+			if (isNull)
+				column.nullBitmap.back() |= std::uint64_t(1) << (row % 64);
+		}
+
+		batch.m_rowCount = row + 1;
+	}
+
+	return row;
+}
+
+long long
+SqliteRecordset::getInt64Value(int index) const
+{
+	if (SQLITE_INTEGER != sqlite3_column_type(m_preparedStmt, index))
+		throw SqliteInvalidTypeError();
+
+	return sqlite3_column_int64(m_preparedStmt, index);
+}
+
+double
+SqliteRecordset::getDoubleValue(int index) const
+{
+	if (SQLITE_FLOAT != sqlite3_column_type(m_preparedStmt, index))
+		throw SqliteInvalidTypeError();
+
+	return sqlite3_column_double(m_preparedStmt, index);
+}
+
+std::string_view
+SqliteRecordset::getTextValue(int index) const
+{
+	if (SQLITE_TEXT != sqlite3_column_type(m_preparedStmt, index))
+		throw SqliteInvalidTypeError();
+
+	auto szValue = sqlite3_column_text(m_preparedStmt, index);
+	auto size = sqlite3_column_bytes(m_preparedStmt, index);
+
+	return std::string_view(reinterpret_cast<const char*>(szValue), size);
+}
+
+std::span<const std::byte>
+SqliteRecordset::getBlobValue(int index) const
+{
+	if (SQLITE_BLOB != sqlite3_column_type(m_preparedStmt, index))
+		throw SqliteInvalidTypeError();
+
+	auto buf = reinterpret_cast<const std::byte*>(sqlite3_column_blob(m_preparedStmt, index));
+	auto bufSize = sqlite3_column_bytes(m_preparedStmt, index);
+
+	return std::span<const std::byte>(buf, bufSize);
+}
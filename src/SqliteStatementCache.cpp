@@ -0,0 +1,171 @@
+#include <cassert>
+#include "sqlite3.h"
+#include "SqliteStatementCache.h"
+
+SqliteStatementCache::SqliteStatementCache(size_t capacity)
+	: m_capacity(capacity)
+{
+}
+
+SqliteStatementCache::~SqliteStatementCache()
+{
+	clear();
+}
+
+sqlite3_stmt*
+SqliteStatementCache::acquire(const std::wstring& sql)
+{
+	return acquire(m_entriesByWSql, sql);
+}
+
+sqlite3_stmt*
+SqliteStatementCache::acquire(std::string_view sql)
+{
+	return acquire(m_entriesBySql, sql);
+}
+
+void
+SqliteStatementCache::add(const std::wstring& sql, sqlite3_stmt* stmt)
+{
+	add(m_entriesByWSql, sql, stmt);
+}
+
+void
+SqliteStatementCache::add(std::string_view sql, sqlite3_stmt* stmt)
+{
+	add(m_entriesBySql, sql, stmt);
+}
+
+template <class TMap, class TSql>
+sqlite3_stmt*
+SqliteStatementCache::acquire(TMap& entriesBySql, const TSql& sql)
+{
+	auto it = entriesBySql.find(sql);
+	if (entriesBySql.end() == it || it->second->borrowed)
+	{
+		++m_stats.misses;
+		return nullptr;
+	}
+
+	++m_stats.hits;
+
+	// Mark as most recently used
+	auto entry = it->second;
+	m_entries.splice(m_entries.begin(), m_entries, entry);
+	entry->borrowed = true;
+
+	return entry->stmt;
+}
+
+template <class TMap, class TSql>
+void
+SqliteStatementCache::add(TMap& entriesBySql, const TSql& sql, sqlite3_stmt* stmt)
+{
+	// Empty SQL produces no statement.
+	// Another copy of the statement might be already cached; this one gets finalized on release
+	if (nullptr == stmt || 0 == m_capacity || entriesBySql.find(sql) != entriesBySql.end())
+		return;
+
+	typename TMap::key_type key(sql);
+
+	m_entries.push_front(Entry{ key, stmt, true });
+	entriesBySql.emplace(std::move(key), m_entries.begin());
+	m_entriesByStmt.emplace(stmt, m_entries.begin());
+
+	evict();
+}
+
+void
+SqliteStatementCache::share(sqlite3_stmt* stmt)
+{
+	assert(stmt);
+	++m_shareCounts[stmt];
+}
+
+void
+SqliteStatementCache::release(sqlite3_stmt* stmt)
+{
+	if (nullptr == stmt)
+		return;
+
+	auto itShared = m_shareCounts.find(stmt);
+	if (m_shareCounts.end() != itShared)
+	{
+		if (0 == --itShared->second)
+			m_shareCounts.erase(itShared);
+
+		return;
+	}
+
+	auto it = m_entriesByStmt.find(stmt);
+	if (m_entriesByStmt.end() == it)
+	{
+		sqlite3_finalize(stmt);
+		return;
+	}
+
+	assert(it->second->borrowed);
+
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+	it->second->borrowed = false;
+
+	// Cache might have been overfilled by borrowed statements
+	evict();
+}
+
+void
+SqliteStatementCache::clear()
+{
+	for (auto& entry : m_entries)
+		sqlite3_finalize(entry.stmt);
+
+	m_entries.clear();
+	m_entriesByWSql.clear();
+	m_entriesBySql.clear();
+	m_entriesByStmt.clear();
+	m_shareCounts.clear();
+}
+
+size_t
+SqliteStatementCache::getCapacity() const
+{
+	return m_capacity;
+}
+
+void
+SqliteStatementCache::setCapacity(size_t capacity)
+{
+	m_capacity = capacity;
+	evict();
+}
+
+const SqliteStatementCache::Stats&
+SqliteStatementCache::getStats() const
+{
+	return m_stats;
+}
+
+void
+SqliteStatementCache::evict()
+{
+	auto it = m_entries.end();
+	while (m_entries.size() > m_capacity && m_entries.begin() != it)
+	{
+		--it;
+		if (it->borrowed)
+			continue;
+
+		sqlite3_finalize(it->stmt);
+
+		if (auto wsql = std::get_if<std::wstring>(&it->sql))
+			m_entriesByWSql.erase(*wsql);
+		else
+			m_entriesBySql.erase(std::get<std::string>(it->sql));
+
+		m_entriesByStmt.erase(it->stmt);
+		it = m_entries.erase(it);
+
+		++m_stats.evictions;
+	}
+}
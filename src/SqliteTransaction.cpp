@@ -1,38 +1,176 @@
 #include <cassert>
+#include "sqlite3.h"
 #include "SqliteTransaction.h"
-#include "SqliteDb.h"
+#include "SqliteStatement.h"
 
-SqliteTransaction::SqliteTransaction(SqliteDb* db)
+// The same savepoint name is used on all levels since a name refers to the most recent savepoint
+typedef SqliteStatement<"SAVEPOINT yasw_transaction"> TSavepointStatement;
+typedef SqliteStatement<"RELEASE yasw_transaction"> TReleaseStatement;
+typedef SqliteStatement<"ROLLBACK TO yasw_transaction"> TRollbackToStatement;
+
+typedef SqliteStatement<"BEGIN DEFERRED TRANSACTION"> TBeginDeferredStatement;
+typedef SqliteStatement<"BEGIN IMMEDIATE TRANSACTION"> TBeginImmediateStatement;
+typedef SqliteStatement<"BEGIN EXCLUSIVE TRANSACTION"> TBeginExclusiveStatement;
+typedef SqliteStatement<"COMMIT"> TCommitStatement;
+typedef SqliteStatement<"ROLLBACK"> TRollbackStatement;
+
+SqliteTransaction::SqliteTransaction(SqliteDb* db, Mode mode)
 	: m_db(db),
+	  m_id(0),
+	  m_level(0),
+	  m_nested(false),
 	  m_complete(false)
 {
 	assert(m_db);
 
-	m_db->execute(L"BEGIN IMMEDIATE TRANSACTION");
+	const bool inTransaction = 0 == sqlite3_get_autocommit(m_db->m_db);
+
+	// Some errors roll back the whole transaction automatically, which completes active instances
+	if (!inTransaction)
+		m_db->m_activeTransactions.clear();
+
+	// Transaction may also be started by SQL or executed batch
+	m_nested = inTransaction;
+
+	if (m_nested)
+		TSavepointStatement::execute(*m_db);
+	else if (Mode::Deferred == mode)
+		TBeginDeferredStatement::execute(*m_db);
+	else if (Mode::Immediate == mode)
+		TBeginImmediateStatement::execute(*m_db);
+	else
+		TBeginExclusiveStatement::execute(*m_db);
+
+	m_id = m_db->m_nextTransactionId++;
+	m_level = m_db->m_activeTransactions.size();
+	m_db->m_activeTransactions.push_back(m_id);
 }
 
 SqliteTransaction::~SqliteTransaction()
 {
-	assert(m_complete);
+	if (m_complete)
+		return;
 
-	if (!m_complete)
+	// Exception must not leave destructor; transaction left open is rolled back on close of the database
+	try
+	{
 		rollback();
+	}
+	catch (...)
+	{
+	}
+}
+
+SqliteTransaction::SqliteTransaction(SqliteTransaction&& rhs) noexcept
+	: m_db(nullptr),
+	  m_id(0),
+	  m_level(0),
+	  m_nested(false),
+	  m_complete(true)
+{
+	moveFrom(std::move(rhs));
+}
+
+SqliteTransaction&
+SqliteTransaction::operator=(SqliteTransaction&& rhs)
+{
+	if (this != &rhs)
+	{
+		if (!m_complete)
+			rollback();
+
+		moveFrom(std::move(rhs));
+	}
+
+	return *this;
+}
+
+void
+SqliteTransaction::moveFrom(SqliteTransaction&& rhs) noexcept
+{
+	m_db = rhs.m_db;
+	m_id = rhs.m_id;
+	m_level = rhs.m_level;
+	m_nested = rhs.m_nested;
+	m_complete = rhs.m_complete;
+
+	// Moved-from instance does nothing on destruction
+	rhs.m_complete = true;
+}
+
+bool
+SqliteTransaction::isNested() const
+{
+	return m_nested;
+}
+
+bool
+SqliteTransaction::isActive() const
+{
+	const auto& activeTransactions = m_db->m_activeTransactions;
+	return !m_complete && m_level < activeTransactions.size() && m_id == activeTransactions[m_level];
 }
 
 void
 SqliteTransaction::commit()
 {
-	assert(!m_complete);
+	if (!isActive())
+		throw SqliteError("Transaction is already complete");
+
+	if (m_level + 1 != m_db->m_activeTransactions.size())
+		throw SqliteError("Nested transaction is not complete");
 
-	m_db->execute(L"COMMIT");
+	if (m_nested)
+		TReleaseStatement::execute(*m_db);
+	else
+		TCommitStatement::execute(*m_db);
+
+	// Failed commit leaves the transaction active
 	m_complete = true;
+	m_db->m_activeTransactions.pop_back();
 }
 
 void
 SqliteTransaction::rollback()
 {
-	assert(!m_complete);
+	if (m_complete)
+		throw SqliteError("Transaction is already complete");
+
+	// Rolled back by enclosing transaction
+	if (!isActive())
+	{
+		m_complete = true;
+		return;
+	}
 
-	m_db->execute(L"ROLLBACK");
+	// Transaction is complete even if rollback fails, so that it is not rolled back again
 	m_complete = true;
+
+	auto& activeTransactions = m_db->m_activeTransactions;
+
+	// Some errors roll back the whole transaction automatically
+	if (0 != sqlite3_get_autocommit(m_db->m_db))
+	{
+		activeTransactions.clear();
+		return;
+	}
+
+	if (!m_nested)
+	{
+		// Nested transactions are rolled back as well
+		activeTransactions.clear();
+		TRollbackStatement::execute(*m_db);
+
+		return;
+	}
+
+	// Savepoints of nested transactions are rolled back from the innermost one.
+	// ROLLBACK TO keeps the savepoint open
+	while (activeTransactions.size() > m_level)
+	{
+		activeTransactions.pop_back();
+
+		TRollbackToStatement::execute(*m_db);
+		TReleaseStatement::execute(*m_db);
+	}
 }
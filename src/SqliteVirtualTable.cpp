@@ -0,0 +1,311 @@
+#include <cassert>
+#include <cmath>
+#include <tuple>
+#include <algorithm>
+#include <exception>
+#include "sqlite3.h"
+#include "SqliteVirtualTable.h"
+#include "SqliteExceptions.h"
+
+struct SqliteVirtualTableSource::Table : sqlite3_vtab
+{
+	SqliteVirtualTableSource* source;
+};
+
+struct SqliteVirtualTableSource::Cursor : sqlite3_vtab_cursor
+{
+	const SqliteVirtualTableSource* source;
+
+	// Rows [index, end) are left to visit
+	size_t index;
+	size_t end;
+};
+
+SqliteVirtualTableSource::ValueType
+SqliteVirtualTableSource::getValueType(sqlite3_value* value)
+{
+	switch (sqlite3_value_type(value))
+	{
+	case SQLITE_INTEGER:
+		return ValueType::Integer;
+
+	case SQLITE_FLOAT:
+		return ValueType::Float;
+
+	case SQLITE_TEXT:
+		return ValueType::Text;
+
+	case SQLITE_BLOB:
+		return ValueType::Blob;
+
+	default:
+		return ValueType::Null;
+	}
+}
+
+void
+SqliteVirtualTableSource::registerModule(sqlite3* db, std::string_view name, SqliteVirtualTableSource* source)
+{
+	// Eponymous-only read-only table: no xCreate, xUpdate
+	static const sqlite3_module module = {
+		0,											// iVersion
+		nullptr,									// xCreate
+		&SqliteVirtualTableSource::connect,			// xConnect
+		&SqliteVirtualTableSource::bestIndex,		// xBestIndex
+		&SqliteVirtualTableSource::disconnect,		// xDisconnect
+		nullptr,									// xDestroy
+		&SqliteVirtualTableSource::open,			// xOpen
+		&SqliteVirtualTableSource::close,			// xClose
+		&SqliteVirtualTableSource::filter,			// xFilter
+		&SqliteVirtualTableSource::next,			// xNext
+		&SqliteVirtualTableSource::eof,				// xEof
+		&SqliteVirtualTableSource::column,			// xColumn
+		&SqliteVirtualTableSource::rowid,			// xRowid
+		nullptr,									// xUpdate
+		nullptr,									// xBegin
+		nullptr,									// xSync
+		nullptr,									// xCommit
+		nullptr,									// xRollback
+		nullptr,									// xFindFunction
+		nullptr,									// xRename
+		nullptr,									// xSavepoint
+		nullptr,									// xRelease
+		nullptr,									// xRollbackTo
+		nullptr,									// xShadowName
+	};
+
+	int res = sqlite3_create_module_v2(db, std::string(name).c_str(), &module, source, &SqliteVirtualTableSource::destroy);
+	if (SQLITE_OK != res)
+		throw SqliteError(sqlite3_errmsg(db));
+}
+
+void
+SqliteVirtualTableSource::destroy(void* source)
+{
+	delete static_cast<SqliteVirtualTableSource*>(source);
+}
+
+int
+SqliteVirtualTableSource::connect(sqlite3* db, void* aux, int, const char* const*, sqlite3_vtab** ppVtab, char**)
+{
+	auto source = static_cast<SqliteVirtualTableSource*>(aux);
+
+	int res = SQLITE_OK;
+	try
+	{
+		res = sqlite3_declare_vtab(db, ("CREATE TABLE x(" + source->getColumnDefinitions() + ")").c_str());
+	}
+	catch (const std::exception&)
+	{
+		return SQLITE_NOMEM;
+	}
+
+	if (SQLITE_OK != res)
+		return res;
+
+	auto table = static_cast<Table*>(sqlite3_malloc(sizeof(Table)));
+	if (nullptr == table)
+		return SQLITE_NOMEM;
+
+	*table = Table{};
+	table->source = source;
+	*ppVtab = table;
+
+	return SQLITE_OK;
+}
+
+int
+SqliteVirtualTableSource::disconnect(sqlite3_vtab* pVtab)
+{
+	sqlite3_free(pVtab);
+	return SQLITE_OK;
+}
+
+int
+SqliteVirtualTableSource::bestIndex(sqlite3_vtab* pVtab, sqlite3_index_info* pIndexInfo)
+{
+	const auto source = static_cast<Table*>(pVtab)->source;
+	const int keyColumn = source->getKeyColumn();
+	const double rowCount = static_cast<double>(std::max<size_t>(source->getRowCount(), 1));
+
+	int eqConstraint = -1;
+	int lowerConstraint = -1;
+	int upperConstraint = -1;
+
+	for (int i = 0; keyColumn >= 0 && i < pIndexInfo->nConstraint; ++i)
+	{
+		const auto& constraint = pIndexInfo->aConstraint[i];
+		if (!constraint.usable || keyColumn != constraint.iColumn)
+			continue;
+
+		// Keys are sorted in BINARY collation
+		const char* szCollation = sqlite3_vtab_collation(pIndexInfo, i);
+		if (nullptr != szCollation && 0 != sqlite3_stricmp(szCollation, "BINARY"))
+			continue;
+
+		switch (constraint.op)
+		{
+		case SQLITE_INDEX_CONSTRAINT_EQ:
+			if (eqConstraint < 0)
+				eqConstraint = i;
+			break;
+
+		case SQLITE_INDEX_CONSTRAINT_GT:
+		case SQLITE_INDEX_CONSTRAINT_GE:
+			if (lowerConstraint < 0)
+				lowerConstraint = i;
+			break;
+
+		case SQLITE_INDEX_CONSTRAINT_LT:
+		case SQLITE_INDEX_CONSTRAINT_LE:
+			if (upperConstraint < 0)
+				upperConstraint = i;
+			break;
+		}
+	}
+
+	// Constraints are not omitted: SQLite rechecks values which cannot be compared with keys
+	int argvIndex = 0;
+	pIndexInfo->idxNum = 0;
+
+	auto useConstraint = [&](int i, int idxBit) {
+		pIndexInfo->aConstraintUsage[i].argvIndex = ++argvIndex;
+		pIndexInfo->idxNum |= idxBit;
+	};
+
+	if (eqConstraint >= 0)
+	{
+		useConstraint(eqConstraint, KEY_EQ);
+
+		pIndexInfo->estimatedCost = std::log2(rowCount) + 1;
+		pIndexInfo->estimatedRows = 1;
+	}
+	else
+	{
+		double selectivity = 1;
+
+		if (lowerConstraint >= 0)
+		{
+			useConstraint(lowerConstraint,
+				SQLITE_INDEX_CONSTRAINT_GT == pIndexInfo->aConstraint[lowerConstraint].op ? KEY_GT : KEY_GE);
+			selectivity /= 2;
+		}
+
+		if (upperConstraint >= 0)
+		{
+			useConstraint(upperConstraint,
+				SQLITE_INDEX_CONSTRAINT_LT == pIndexInfo->aConstraint[upperConstraint].op ? KEY_LT : KEY_LE);
+			selectivity /= 2;
+		}
+
+		pIndexInfo->estimatedCost = rowCount * selectivity + (argvIndex > 0 ? std::log2(rowCount) : 0);
+		pIndexInfo->estimatedRows = static_cast<sqlite3_int64>(rowCount * selectivity);
+	}
+
+	// Rows are visited in key order.
+	// sqlite3_vtab_collation() covers constraints only, but SQLite passes ORDER BY terms
+	// only if their collation is the declared collation of the column
+	if (keyColumn >= 0 &&
+		1 == pIndexInfo->nOrderBy &&
+		keyColumn == pIndexInfo->aOrderBy[0].iColumn &&
+		!pIndexInfo->aOrderBy[0].desc &&
+		0 == sqlite3_stricmp(source->getKeyCollation(), "BINARY"))
+	{
+		pIndexInfo->orderByConsumed = 1;
+	}
+
+	return SQLITE_OK;
+}
+
+int
+SqliteVirtualTableSource::open(sqlite3_vtab* pVtab, sqlite3_vtab_cursor** ppCursor)
+{
+	auto cursor = static_cast<Cursor*>(sqlite3_malloc(sizeof(Cursor)));
+	if (nullptr == cursor)
+		return SQLITE_NOMEM;
+
+	*cursor = Cursor{};
+	cursor->source = static_cast<Table*>(pVtab)->source;
+	*ppCursor = cursor;
+
+	return SQLITE_OK;
+}
+
+int
+SqliteVirtualTableSource::close(sqlite3_vtab_cursor* pCursor)
+{
+	sqlite3_free(pCursor);
+	return SQLITE_OK;
+}
+
+int
+SqliteVirtualTableSource::filter(sqlite3_vtab_cursor* pCursor, int idxNum, const char*, int argc, sqlite3_value** argv)
+{
+	auto cursor = static_cast<Cursor*>(pCursor);
+	auto source = cursor->source;
+
+	size_t first = 0;
+	size_t last = source->getRowCount();
+	int argIndex = 0;
+
+	auto applyConstraint = [&](int idxBit, KeyOperator op) {
+		if (0 != (idxNum & idxBit) && argIndex < argc)
+			std::tie(first, last) = source->findKeyRange(op, argv[argIndex++], first, last);
+	};
+
+	try
+	{
+		applyConstraint(KEY_EQ, KeyOperator::Equal);
+		applyConstraint(KEY_GT, KeyOperator::Greater);
+		applyConstraint(KEY_GE, KeyOperator::GreaterOrEqual);
+		applyConstraint(KEY_LT, KeyOperator::Less);
+		applyConstraint(KEY_LE, KeyOperator::LessOrEqual);
+	}
+	catch (const std::exception&)
+	{
+		return SQLITE_ERROR;
+	}
+
+	cursor->index = first;
+	cursor->end = std::max(first, last);
+
+	return SQLITE_OK;
+}
+
+int
+SqliteVirtualTableSource::next(sqlite3_vtab_cursor* pCursor)
+{
+	++static_cast<Cursor*>(pCursor)->index;
+	return SQLITE_OK;
+}
+
+int
+SqliteVirtualTableSource::eof(sqlite3_vtab_cursor* pCursor)
+{
+	auto cursor = static_cast<Cursor*>(pCursor);
+	return cursor->index >= cursor->end;
+}
+
+int
+SqliteVirtualTableSource::column(sqlite3_vtab_cursor* pCursor, sqlite3_context* context, int index)
+{
+	auto cursor = static_cast<Cursor*>(pCursor);
+
+	try
+	{
+		cursor->source->getColumnValue(cursor->index, index, context);
+	}
+	catch (...)
+	{
+		SqliteFunction::setError(context, std::current_exception());
+	}
+
+	return SQLITE_OK;
+}
+
+int
+SqliteVirtualTableSource::rowid(sqlite3_vtab_cursor* pCursor, long long* pRowid)
+{
+	*pRowid = static_cast<long long>(static_cast<Cursor*>(pCursor)->index) + 1;
+	return SQLITE_OK;
+}
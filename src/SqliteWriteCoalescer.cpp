@@ -0,0 +1,142 @@
+#include <cassert>
+#include "SqliteWriteCoalescer.h"
+#include "SqliteDb.h"
+
+SqliteWriteCoalescer::SqliteWriteCoalescer(SqliteDb& db, size_t maxBatchSize, std::chrono::microseconds maxDelay)
+	: m_db(db),
+	  m_maxBatchSize(maxBatchSize),
+	  m_maxDelay(maxDelay),
+	  m_stopping(false)
+{
+	assert(m_maxBatchSize > 0);
+
+	m_thread = std::thread(&SqliteWriteCoalescer::run, this);
+}
+
+SqliteWriteCoalescer::~SqliteWriteCoalescer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+
+	m_condition.notify_all();
+	m_thread.join();
+}
+
+std::future<void>
+SqliteWriteCoalescer::submit(TWrite write)
+{
+	PendingWrite pendingWrite{ std::move(write), std::promise<void>() };
+	auto future = pendingWrite.promise.get_future();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		assert(!m_stopping);
+
+		m_pendingWrites.push_back(std::move(pendingWrite));
+	}
+
+	m_condition.notify_all();
+
+	return future;
+}
+
+void
+SqliteWriteCoalescer::run()
+{
+	std::vector<PendingWrite> batch;
+
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			m_condition.wait(lock, [this]() {
+				return !m_pendingWrites.empty() || m_stopping;
+			});
+
+			if (m_pendingWrites.empty())
+				break;
+
+			// Collect more writes during the time window started by the first one
+			const auto deadline = std::chrono::steady_clock::now() + m_maxDelay;
+			m_condition.wait_until(lock, deadline, [this]() {
+				return m_pendingWrites.size() >= m_maxBatchSize || m_stopping;
+			});
+
+			while (!m_pendingWrites.empty() && batch.size() < m_maxBatchSize)
+			{
+				batch.push_back(std::move(m_pendingWrites.front()));
+				m_pendingWrites.pop_front();
+			}
+		}
+
+		commitBatch(batch);
+		batch.clear();
+	}
+}
+
+void
+SqliteWriteCoalescer::commitBatch(std::vector<PendingWrite>& batch)
+{
+	std::vector<std::exception_ptr> errors(batch.size());
+
+	try
+	{
+		auto transaction = m_db.beginTransaction();
+
+		try
+		{
+			for (size_t i = 0; i < batch.size(); ++i)
+				errors[i] = executeWrite(batch[i].write);
+
+			transaction.commit();
+		}
+		catch (...)
+		{
+			transaction.rollback();
+			throw;
+		}
+	}
+	catch (...)
+	{
+		// Nothing has been committed
+		auto error = std::current_exception();
+		for (auto& pendingWrite : batch)
+			pendingWrite.promise.set_exception(error);
+
+		return;
+	}
+
+	for (size_t i = 0; i < batch.size(); ++i)
+	{
+		if (errors[i])
+			batch[i].promise.set_exception(errors[i]);
+		else
+			batch[i].promise.set_value();
+	}
+}
+
+std::exception_ptr
+SqliteWriteCoalescer::executeWrite(const TWrite& write)
+{
+	// Nested transaction of the batch
+	auto transaction = m_db.beginTransaction();
+
+	try
+	{
+		write(m_db);
+	}
+	catch (...)
+	{
+		auto error = std::current_exception();
+		transaction.rollback();
+
+		return error;
+	}
+
+	transaction.commit();
+
+	return nullptr;
+}
@@ -0,0 +1,254 @@
+#include <string>
+#include <cstdio>
+#include <thread>
+#include <future>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include "SqliteAsyncDb.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(testSuiteSqliteAsyncDb)
+
+namespace {
+
+	struct SqliteAsyncDbFixture
+	{
+		SqliteAsyncDbFixture()
+		{
+			m_tempFileName = std::tmpnam(nullptr);
+			m_sqliteDb = std::make_unique<SqliteAsyncDb>(m_tempFileName);
+
+			m_sqliteDb->execute("create table products ( id integer primary key, name text not null, price real null )");
+		}
+
+		~SqliteAsyncDbFixture()
+		{
+			m_sqliteDb.reset();
+			std::remove(m_tempFileName.c_str());
+		}
+
+		std::string m_tempFileName;
+		std::unique_ptr<SqliteAsyncDb> m_sqliteDb;
+	};
+
+	// Coroutine started eagerly, completion is signaled by the future
+	struct Task
+	{
+		struct promise_type
+		{
+			std::promise<void> promise;
+
+			Task get_return_object()
+			{
+				return Task{ promise.get_future() };
+			}
+
+			std::suspend_never initial_suspend() noexcept
+			{
+				return {};
+			}
+
+			std::suspend_never final_suspend() noexcept
+			{
+				return {};
+			}
+
+			void return_void()
+			{
+				promise.set_value();
+			}
+
+			void unhandled_exception()
+			{
+				promise.set_exception(std::current_exception());
+			}
+		};
+
+		std::future<void> done;
+	};
+
+	// Executor resuming coroutines on the thread calling run()
+	class ManualExecutor
+	{
+	public:
+		void post(std::coroutine_handle<> handle)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_handles.push_back(handle);
+			m_cv.notify_one();
+		}
+
+		void run(std::future<void>& done)
+		{
+			while (std::future_status::ready != done.wait_for(std::chrono::seconds(0)))
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				if (!m_cv.wait_for(lock, std::chrono::milliseconds(10), [this]() { return !m_handles.empty(); }))
+					continue;
+
+				auto handle = m_handles.front();
+				m_handles.pop_front();
+				lock.unlock();
+
+				BOOST_CHECK(std::this_thread::get_id() == m_threadId);
+				handle.resume();
+			}
+
+			done.get();
+		}
+
+	private:
+		const std::thread::id m_threadId{ std::this_thread::get_id() };
+		std::mutex m_mutex;
+		std::condition_variable m_cv;
+		std::deque<std::coroutine_handle<>> m_handles;
+	};
+
+} // namespace
+
+BOOST_FIXTURE_TEST_CASE(testJobsFromManyThreads, SqliteAsyncDbFixture)
+{
+	const int threadCount = 8;
+	const int jobCount = 200;
+
+	std::vector<std::thread> threads;
+	std::vector<std::vector<std::future<void>>> results(threadCount);
+
+	for (int t = 0; t < threadCount; ++t)
+	{
+		threads.emplace_back([this, t, &results]() {
+			for (int i = 0; i < jobCount; ++i)
+			{
+				// Argument views are copied
+				const std::string name = "product " + std::to_string(t * jobCount + i);
+				results[t].push_back(m_sqliteDb->execute("insert into products (name) values (?)", std::string_view(name)));
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	for (auto& threadResults : results)
+		for (auto& result : threadResults)
+			result.get();
+
+	auto count = m_sqliteDb->submit([](SqliteDb& db) {
+		return db.select("select count(*) from products").getInt(0).value();
+	});
+
+	BOOST_CHECK_EQUAL(count.get(), threadCount * jobCount);
+}
+
+BOOST_FIXTURE_TEST_CASE(testSelect, SqliteAsyncDbFixture)
+{
+	m_sqliteDb->execute("insert into products (id, name, price) values (?, ?, ?)", 1, "bread", 1.5);
+	m_sqliteDb->execute("insert into products (id, name, price) values (?, ?, ?)", 2, "milk", nullptr);
+
+	auto rows = m_sqliteDb->select<long long, std::string, std::optional<double>>(
+		"select id, name, price from products where id >= ? order by id", 1).get();
+
+	BOOST_REQUIRE_EQUAL(rows.size(), 2);
+	BOOST_CHECK_EQUAL(std::get<1>(rows[0]), "bread");
+	BOOST_CHECK(std::get<2>(rows[0]) == 1.5);
+	BOOST_CHECK(!std::get<2>(rows[1]).has_value());
+
+	{
+		// Worker is held until views passed to the queued job are destroyed
+		std::promise<void> resume;
+		auto blocked = m_sqliteDb->submit([resumed = resume.get_future().share()](SqliteDb&) { resumed.wait(); });
+
+		std::future<void> inserted;
+		{
+			std::string name = "butter";
+			std::wstring wname = L"cheese";
+			std::vector<std::byte> bytes(3, std::byte{ 'x' });
+
+			m_sqliteDb->execute("insert into products (id, name) values (?, ?)", 3, std::optional<std::string_view>(name));
+			m_sqliteDb->execute("insert into products (id, name) values (?, ?)", 4, wname.c_str());
+			inserted = m_sqliteDb->execute("insert into products (id, name) values (?, cast(? as text))", 5,
+				std::optional<std::span<const std::byte>>(bytes));
+
+			name.assign(name.size(), '?');
+			wname.assign(wname.size(), L'?');
+			bytes.assign(bytes.size(), std::byte{ '?' });
+		}
+
+		resume.set_value();
+		blocked.get();
+		inserted.get();
+
+		auto names = m_sqliteDb->select<std::string>("select name from products where id >= 3 order by id").get();
+		BOOST_REQUIRE_EQUAL(names.size(), 3);
+		BOOST_CHECK_EQUAL(std::get<0>(names[0]), "butter");
+		BOOST_CHECK_EQUAL(std::get<0>(names[1]), "cheese");
+		BOOST_CHECK_EQUAL(std::get<0>(names[2]), "xxx");
+	}
+
+	// Errors are delivered through futures
+	BOOST_CHECK_THROW(m_sqliteDb->execute("insert into missing (id) values (1)").get(), SqliteError);
+	BOOST_CHECK_THROW(m_sqliteDb->select<double>("select price from products where id = 2").get(), SqliteInvalidTypeError);
+}
+
+BOOST_FIXTURE_TEST_CASE(testCoroutines, SqliteAsyncDbFixture)
+{
+	ManualExecutor executor;
+	m_sqliteDb->setExecutor([&executor](std::coroutine_handle<> handle) { executor.post(handle); });
+
+	auto task = [](SqliteAsyncDb& db) -> Task {
+		for (int i = 1; i <= 1000; ++i)
+			co_await db.executeAsync("insert into products (id, name) values (?, ?)", i, std::string_view("product " + std::to_string(i)));
+
+		auto count = co_await db.submitAsync([](SqliteDb& db) {
+			return db.select("select count(*) from products").getInt(0).value();
+		});
+		BOOST_CHECK_EQUAL(count, 1000);
+
+		auto rows = co_await db.selectAsync<std::string>("select name from products where id = ?", 7);
+		BOOST_REQUIRE_EQUAL(rows.size(), 1);
+		BOOST_CHECK_EQUAL(std::get<0>(rows[0]), "product 7");
+
+		// Rows are read in batches
+		auto products = db.streamAsync<long long, std::string>("select id, name from products order by id", 300);
+
+		long long expectedId = 1;
+		size_t batchCount = 0;
+
+		for (auto batch = co_await products.next(); !batch.empty(); batch = co_await products.next())
+		{
+			++batchCount;
+			BOOST_CHECK(batch.size() <= 300);
+
+			for (const auto& [id, name] : batch)
+				BOOST_CHECK_EQUAL(id, expectedId++);
+		}
+
+		BOOST_CHECK_EQUAL(batchCount, 4);
+		BOOST_CHECK_EQUAL(expectedId, 1001);
+
+		// Abandoned stream releases its statement
+		{
+			auto abandoned = db.streamAsync<long long>("select id from products", 10);
+			BOOST_CHECK_EQUAL((co_await abandoned.next()).size(), 10);
+		}
+
+		co_await db.executeAsync("drop table products");
+
+		// Errors are rethrown in the coroutine
+		BOOST_CHECK_THROW(co_await db.executeAsync("insert into products (id) values (1)"), SqliteError);
+	}(*m_sqliteDb);
+
+	executor.run(task.done);
+}
+
+BOOST_AUTO_TEST_CASE(testOpenError)
+{
+	SqliteDbOptions options;
+	options.readOnly = true;
+
+	BOOST_CHECK_THROW(SqliteAsyncDb("/nonexistent/dir/test.db", options), SqliteError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
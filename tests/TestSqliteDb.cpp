@@ -1,7 +1,13 @@
 #include <string>
 #include <cstdio>
 #include <codecvt>
+#include <algorithm>
+#include <vector>
+#include <optional>
+#include <thread>
+#include <atomic>
 #include "SqliteDb.h"
+#include "SqliteStatement.h"
 
 #define BOOST_TEST_MODULE testSqliteDb
 #include <boost/test/included/unit_test.hpp>
@@ -33,6 +39,75 @@ namespace {
 		std::unique_ptr<SqliteDb> m_sqliteDb;
 	};
 
+	struct Product
+	{
+		long long id;
+		std::string name;
+		std::optional<double> price;
+	};
+
+	// Aggregate function
+	struct Median
+	{
+		std::vector<double> values;
+
+		void step(double value)
+		{
+			values.push_back(value);
+		}
+
+		std::optional<double> final()
+		{
+			if (values.empty())
+				return std::nullopt;
+
+			auto middle = values.begin() + values.size() / 2;
+			std::nth_element(values.begin(), middle, values.end());
+
+			return *middle;
+		}
+	};
+
+	// Aggregate window function
+	struct Average
+	{
+		double sum = 0;
+		long long count = 0;
+
+		void step(double value)
+		{
+			sum += value;
+			++count;
+		}
+
+		void inverse(double value)
+		{
+			sum -= value;
+			--count;
+		}
+
+		std::optional<double> value() const
+		{
+			return count > 0 ? std::optional(sum / count) : std::nullopt;
+		}
+
+		std::optional<double> final()
+		{
+			return value();
+		}
+	};
+
+	// Statements executed during static initialization, before other statics of the program are initialized
+	const std::vector<long long> STATIC_INIT_RESULTS = []() {
+		SqliteDb db(":memory:");
+
+		std::vector<long long> results;
+		results.push_back(SqliteStatement<"select 1">::select(db).getInt64(0).value());
+		results.push_back(SqliteStatement<"select 2">::select(db).getInt64(0).value());
+
+		return results;
+	}();
+
 } // namespace
 
 BOOST_FIXTURE_TEST_CASE(testSpacesAtTheEndOfStatement, SqliteDbFixture)
@@ -182,6 +257,152 @@ BOOST_FIXTURE_TEST_CASE(testTransaction, SqliteDbFixture)
 	m_sqliteDb->execute(L"drop table products");
 }
 
+BOOST_FIXTURE_TEST_CASE(testNestedTransaction, SqliteDbFixture)
+{
+	m_sqliteDb->execute("create table products ( id integer primary key, name text not null )");
+
+	auto countProducts = [this]() {
+		return m_sqliteDb->select("select count(*) from products").getInt(0).value();
+	};
+
+	auto transaction = m_sqliteDb->beginTransaction(SqliteTransaction::Mode::Deferred);
+	BOOST_CHECK(!transaction.isNested());
+
+	m_sqliteDb->execute("insert into products (name) values ('bread')");
+
+	{
+		// Rolled back changes of nested transaction only
+		auto nested = m_sqliteDb->beginTransaction();
+		BOOST_CHECK(nested.isNested());
+
+		m_sqliteDb->execute("insert into products (name) values ('milk')");
+
+		{
+			auto innermost = m_sqliteDb->beginTransaction();
+			m_sqliteDb->execute("insert into products (name) values ('butter')");
+
+			// Enclosing transaction cannot be completed first
+			BOOST_CHECK_THROW(nested.commit(), SqliteError);
+
+			innermost.commit();
+		}
+
+		BOOST_CHECK_EQUAL(countProducts(), 3);
+
+		nested.rollback();
+		BOOST_CHECK_THROW(nested.rollback(), SqliteError);
+	}
+
+	BOOST_CHECK_EQUAL(countProducts(), 1);
+
+	{
+		auto nested = m_sqliteDb->beginTransaction();
+		m_sqliteDb->execute("insert into products (name) values ('milk')");
+
+		// Moved transaction stays active
+		auto moved = std::move(nested);
+		moved.commit();
+	}
+
+	transaction.commit();
+	BOOST_CHECK_EQUAL(countProducts(), 2);
+
+	// Enclosing transaction destroyed first rolls back the nested one
+	{
+		auto outer = std::make_unique<SqliteTransaction>(m_sqliteDb->beginTransaction());
+		auto nested = m_sqliteDb->beginTransaction();
+		m_sqliteDb->execute("insert into products (name) values ('butter')");
+
+		outer.reset();
+		BOOST_CHECK_THROW(nested.commit(), SqliteError);
+
+		auto next = m_sqliteDb->beginTransaction();
+		BOOST_CHECK(!next.isNested());
+
+		m_sqliteDb->execute("insert into products (name) values ('butter')");
+		next.commit();
+	}
+
+	BOOST_CHECK_EQUAL(countProducts(), 3);
+	m_sqliteDb->execute("delete from products where name = 'butter'");
+
+	// Transaction started by SQL is enclosing one
+	m_sqliteDb->execute("BEGIN");
+	{
+		auto nested = m_sqliteDb->beginTransaction(SqliteTransaction::Mode::Exclusive);
+		BOOST_CHECK(nested.isNested());
+
+		m_sqliteDb->execute("delete from products");
+		nested.rollback();
+	}
+	m_sqliteDb->execute("COMMIT");
+
+	BOOST_CHECK_EQUAL(countProducts(), 2);
+
+	m_sqliteDb->execute("drop table products");
+}
+
+BOOST_FIXTURE_TEST_CASE(testTransactionRetry, SqliteDbFixture)
+{
+	m_sqliteDb->execute("create table products ( id integer primary key, name text not null )");
+
+	SqliteRetryPolicy retryPolicy;
+	retryPolicy.maxAttempts = 3;
+	retryPolicy.initialDelay = std::chrono::milliseconds(1);
+
+	{
+		// Write lock is held by the other connection
+		SqliteDb otherDb(m_tempFileName);
+		auto otherTransaction = otherDb.beginTransaction();
+
+		int runCount = 0;
+		BOOST_CHECK_THROW(m_sqliteDb->withTransaction([&runCount](SqliteDb&) { ++runCount; }, retryPolicy), SqliteBusyError);
+		BOOST_CHECK_EQUAL(runCount, 0);
+		BOOST_CHECK_EQUAL(m_sqliteDb->getBusyStats().retryCount, 2);
+
+		// Lock is released between attempts
+		SqliteBusyPolicy busyPolicy;
+		busyPolicy.strategy = SqliteBusyPolicy::Strategy::Callback;
+		busyPolicy.callback = [&otherTransaction](int, std::chrono::milliseconds) {
+			otherTransaction.rollback();
+			return false;
+		};
+		m_sqliteDb->setBusyPolicy(busyPolicy);
+
+		auto id = m_sqliteDb->withTransaction([&runCount](SqliteDb& db) {
+			++runCount;
+			db.execute("insert into products (name) values ('bread')");
+
+			return db.select("select last_insert_rowid()").getInt64(0).value();
+		}, retryPolicy);
+
+		BOOST_CHECK_EQUAL(id, 1);
+		BOOST_CHECK_EQUAL(runCount, 1);
+		BOOST_CHECK_EQUAL(m_sqliteDb->getBusyStats().retryCount, 3);
+	}
+
+	// Other errors are not retried
+	int runCount = 0;
+	BOOST_CHECK_THROW(m_sqliteDb->withTransaction([&runCount](SqliteDb& db) {
+		++runCount;
+		db.execute("insert into products (name) values ('milk')");
+		db.execute("insert into products (name) values (null)");
+	}), SqliteError);
+
+	BOOST_CHECK_EQUAL(runCount, 1);
+	BOOST_CHECK_EQUAL(m_sqliteDb->select("select count(*) from products").getInt(0).value(), 1);
+
+	// Incomplete transaction is rolled back on destruction
+	{
+		auto transaction = m_sqliteDb->beginTransaction();
+		m_sqliteDb->execute("delete from products");
+	}
+
+	BOOST_CHECK_EQUAL(m_sqliteDb->select("select count(*) from products").getInt(0).value(), 1);
+
+	m_sqliteDb->execute("drop table products");
+}
+
 BOOST_FIXTURE_TEST_CASE(testStandalonePreparedCommand, SqliteDbFixture)
 {
 	m_sqliteDb->execute(L"create table products ( id integer primary key, name text not null )");
@@ -195,4 +416,742 @@ BOOST_FIXTURE_TEST_CASE(testStandalonePreparedCommand, SqliteDbFixture)
 	m_sqliteDb->execute(L"drop table products");
 }
 
+BOOST_FIXTURE_TEST_CASE(testStatementCache, SqliteDbFixture)
+{
+	m_sqliteDb->execute(L"create table products ( id integer primary key, name text not null )");
+
+	auto sql = L"insert into products (name) values (?)";
+
+	const auto stats1 = m_sqliteDb->getStatementCacheStats();
+
+	m_sqliteDb->prepare(sql)
+		.addParameter(L"bread")
+		.execute();
+
+	m_sqliteDb->prepare(sql)
+		.addParameter(L"butter")
+		.execute();
+
+	const auto stats2 = m_sqliteDb->getStatementCacheStats();
+	BOOST_CHECK_EQUAL(stats1.misses + 1, stats2.misses);
+	BOOST_CHECK_EQUAL(stats1.hits + 1, stats2.hits);
+
+	// Cached statement must not keep previous bindings
+	BOOST_CHECK_THROW(m_sqliteDb->prepare(sql).execute(), SqliteError);
+
+	// Evict everything but the most recently used statement
+	m_sqliteDb->setStatementCacheCapacity(1);
+	m_sqliteDb->select(L"select 1");
+	m_sqliteDb->select(L"select 2");
+
+	const auto stats3 = m_sqliteDb->getStatementCacheStats();
+	BOOST_CHECK(stats3.evictions > stats2.evictions);
+
+	int recCount = m_sqliteDb->select(L"select count(*) from products")
+		.getInt(0)
+		.value();
+	BOOST_CHECK_EQUAL(recCount, 2);
+
+	m_sqliteDb->execute(L"drop table products");
+}
+
+BOOST_FIXTURE_TEST_CASE(testPersistentCommand, SqliteDbFixture)
+{
+	m_sqliteDb->execute(L"create table products ( id integer primary key, name text null )");
+
+	auto cmd = m_sqliteDb->preparePersistent(L"insert into products (id, name) values (?, ?)");
+	BOOST_CHECK(cmd.isPersistent());
+
+	for (int i = 0; i < 100; ++i)
+	{
+		cmd.addParameter(i)
+			.addParameter(L"item")
+			.execute();
+	}
+
+	// Bindings are kept by reset(), cleared by rebind()
+	cmd.addParameter(100);
+	cmd.reset()
+		.addParameter(101)
+		.execute();
+
+	cmd.rebind()
+		.addParameter(102)
+		.execute();
+
+	auto query = m_sqliteDb->preparePersistent(L"select count(*) from products where name is ?");
+
+	for (int i = 0; i < 2; ++i)
+	{
+		int itemCount = query.addParameter(L"item")
+			.select()
+			.getInt(0)
+			.value();
+		BOOST_CHECK_EQUAL(itemCount, 101);
+	}
+
+	int nullCount = query.addParameterNull()
+		.select()
+		.getInt(0)
+		.value();
+	BOOST_CHECK_EQUAL(nullCount, 1);
+
+	// Recordset outlives temporary command
+	{
+		auto rs = m_sqliteDb->preparePersistent(L"select id from products where id > ? and id < 4 order by id")
+			.addParameter(1)
+			.select();
+
+		std::vector<int> ids;
+		for (; rs; ++rs)
+			ids.push_back(rs.getInt(0).value());
+
+		BOOST_CHECK(ids == std::vector<int>({ 2, 3 }));
+	}
+
+	// Command outlives its recordset and keeps working
+	auto rangeQuery = m_sqliteDb->preparePersistent(L"select count(*) from products where id < ?");
+	for (int i = 1; i <= 2; ++i)
+	{
+		auto rs = rangeQuery.addParameter(i).select();
+		BOOST_CHECK_EQUAL(rs.getInt(0).value(), i);
+	}
+
+	m_sqliteDb->execute(L"drop table products");
+}
+
+BOOST_FIXTURE_TEST_CASE(testUtf8Statements, SqliteDbFixture)
+{
+	m_sqliteDb->execute("create table products ( id integer primary key, name text not null );  ");
+
+	m_sqliteDb->prepare("insert into products (name) values (?)")
+		.addParameter("bread")
+		.execute();
+
+	std::string name = m_sqliteDb->select("select name from products").getString(0).value();
+	BOOST_CHECK_EQUAL(name, "bread");
+
+	auto sql = "insert into products (name) values ('test'); "
+		"select max(last_insert_rowid()) from products";
+
+	BOOST_CHECK_THROW(m_sqliteDb->prepare(sql).execute(), MultipleStatementsUnsupportedError);
+
+	m_sqliteDb->execute("drop table products");
+
+	// Open the same DB file by UTF-8 name
+	m_sqliteDb = std::make_unique<SqliteDb>(m_tempFileName);
+	m_sqliteDb->execute("create table dummy ( id integer primary key )");
+	m_sqliteDb->execute("drop table dummy");
+}
+
+BOOST_FIXTURE_TEST_CASE(testColumnBatchFetch, SqliteDbFixture)
+{
+	m_sqliteDb->execute("create table products ( id integer primary key, name text null, price real null )");
+
+	auto insert = m_sqliteDb->preparePersistent("insert into products (id, name, price) values (?, ?, ?)");
+	for (int i = 0; i < 150; ++i)
+	{
+		insert.addParameter(i);
+
+		if (i % 10)
+			insert.addParameter(std::to_string(i));
+		else
+			insert.addParameterNull();
+
+		insert.addParameter(i * 0.5)
+			.execute();
+	}
+
+	SqliteColumnBatch batch{
+		SqliteColumnBatch::ColumnType::Int64,
+		SqliteColumnBatch::ColumnType::Text,
+		SqliteColumnBatch::ColumnType::Double };
+
+	auto rs = m_sqliteDb->select("select id, name, price from products order by id");
+
+	size_t total = 0;
+	size_t fetched = 0;
+	while ((fetched = rs.fetchBatch(batch, 64)) > 0)
+	{
+		BOOST_CHECK_EQUAL(fetched, batch.getRowCount());
+
+		for (size_t row = 0; row < fetched; ++row, ++total)
+		{
+			BOOST_CHECK_EQUAL(batch.getColumn(0).int64Values[row], total);
+			BOOST_CHECK_EQUAL(batch.getColumn(2).doubleValues[row], total * 0.5);
+
+			if (total % 10)
+				BOOST_CHECK_EQUAL(batch.getText(1, row), std::to_string(total));
+			else
+				BOOST_CHECK(batch.isNull(1, row));
+		}
+	}
+
+	BOOST_CHECK_EQUAL(total, 150);
+	BOOST_CHECK(!rs);
+
+	m_sqliteDb->execute("drop table products");
+}
+
+BOOST_FIXTURE_TEST_CASE(testOptions, SqliteDbFixture)
+{
+	m_sqliteDb.reset();
+
+	SqliteDbOptions options;
+	options.journalMode = SqliteDbOptions::JournalMode::Wal;
+	options.synchronous = SqliteDbOptions::Synchronous::Normal;
+	options.cacheSize = -4096;
+	options.busyTimeout = std::chrono::seconds(1);
+
+	m_sqliteDb = std::make_unique<SqliteDb>(m_tempFileName, options);
+
+	auto journalMode = m_sqliteDb->select("PRAGMA journal_mode").getString(0).value();
+	BOOST_CHECK_EQUAL(journalMode, "wal");
+
+	int synchronous = m_sqliteDb->select("PRAGMA synchronous").getInt(0).value();
+	BOOST_CHECK_EQUAL(synchronous, 1);
+
+	m_sqliteDb->execute("create table products ( id integer primary key, name text not null )");
+
+	// Read-only connection to the same WAL database
+	SqliteDbOptions readOnlyOptions;
+	readOnlyOptions.readOnly = true;
+	readOnlyOptions.journalMode.reset();
+
+	SqliteDb readOnlyDb(m_tempFileName, readOnlyOptions);
+	BOOST_CHECK_THROW(readOnlyDb.execute("insert into products (name) values ('bread')"), SqliteError);
+
+	int recCount = readOnlyDb.select("select count(*) from products").getInt(0).value();
+	BOOST_CHECK_EQUAL(recCount, 0);
+
+	// Unknown VFS
+	SqliteDbOptions vfsOptions;
+	vfsOptions.vfs = "no-such-vfs";
+	BOOST_CHECK_THROW(SqliteDb(m_tempFileName, vfsOptions), SqliteError);
+
+	m_sqliteDb->execute("drop table products");
+}
+
+BOOST_FIXTURE_TEST_CASE(testProfiling, SqliteDbFixture)
+{
+	BOOST_CHECK_EQUAL(SqliteProfiler::normalizeSql("select  *\nfrom t where a = 'x''y' and b=42 and c1 = ?"),
+		"select * from t where a = ? and b=? and c1 = ?");
+
+	m_sqliteDb->execute("create table products ( id integer primary key, name text not null )");
+
+	// Snapshot is taken by another thread while profiling is being enabled
+	{
+		std::thread monitor([this]() {
+			for (int i = 0; i < 100; ++i)
+				m_sqliteDb->getProfileSnapshot();
+		});
+
+		m_sqliteDb->setProfilingEnabled(true);
+		monitor.join();
+	}
+
+	std::vector<std::string> names{ "bread", "butter", "milk" };
+	m_sqliteDb->prepare("insert into products (name) values (?)")
+		.executeBatch(names);
+
+	for (int i = 0; i < 2; ++i)
+		for (auto rs = m_sqliteDb->select("select id, name from products where id > " + std::to_string(i)); rs; ++rs);
+
+	m_sqliteDb->setProfilingEnabled(false);
+
+	// Not profiled
+	m_sqliteDb->select("select id, name from products where id > 5");
+
+	auto snapshot = m_sqliteDb->getProfileSnapshot();
+
+	auto it = std::find_if(snapshot.begin(), snapshot.end(), [](const auto& profile) {
+		return profile.sql == "select id, name from products where id > ?";
+	});
+
+	BOOST_REQUIRE(snapshot.end() != it);
+	BOOST_CHECK_EQUAL(it->callCount, 2);
+	BOOST_CHECK_EQUAL(it->rowCount, 5);
+	BOOST_CHECK(it->vmSteps > 0);
+	BOOST_CHECK(it->minTime <= it->p50Time && it->p50Time <= it->maxTime);
+	BOOST_CHECK(it->totalTime >= it->maxTime);
+
+	it = std::find_if(snapshot.begin(), snapshot.end(), [](const auto& profile) {
+		return profile.sql == "insert into products (name) values (?)";
+	});
+
+	BOOST_REQUIRE(snapshot.end() != it);
+	BOOST_CHECK_EQUAL(it->callCount, 3);
+
+	// Statements with inline literals are aggregated beyond the normalized SQL cache
+	m_sqliteDb->resetProfile();
+	m_sqliteDb->setProfilingEnabled(true);
+
+	const auto statementCount = SqliteProfiler::NORMALIZED_SQL_CACHE_SIZE + 10;
+	for (size_t i = 0; i < statementCount; ++i)
+		m_sqliteDb->select("select name from products where id = " + std::to_string(i));
+
+	m_sqliteDb->setProfilingEnabled(false);
+
+	snapshot = m_sqliteDb->getProfileSnapshot();
+	BOOST_REQUIRE_EQUAL(snapshot.size(), 1);
+	BOOST_CHECK_EQUAL(snapshot[0].callCount, statementCount);
+
+	m_sqliteDb->resetProfile();
+	BOOST_CHECK(m_sqliteDb->getProfileSnapshot().empty());
+
+	m_sqliteDb->execute("drop table products");
+}
+
+BOOST_FIXTURE_TEST_CASE(testTypedQuery, SqliteDbFixture)
+{
+	m_sqliteDb->execute("create table products ( id integer primary key, name text not null, price real null )");
+
+	std::vector<std::tuple<int, std::string, std::optional<double>>> rows{
+		{ 1, "bread", 1.5 }, { 2, "butter", std::nullopt }, { 3, "milk", 0.75 } };
+
+	m_sqliteDb->prepare("insert into products (id, name, price) values (?, ?, ?)")
+		.executeBatch(rows);
+
+	{
+		auto query = m_sqliteDb->query<std::int64_t, std::string_view, std::optional<double>>(
+			"select id, name, price from products where id >= ? order by id", 1);
+		static_assert(std::ranges::input_range<decltype(query)>);
+
+		size_t i = 0;
+		for (auto [id, name, price] : query)
+		{
+			BOOST_REQUIRE(i < rows.size());
+			BOOST_CHECK_EQUAL(id, std::get<0>(rows[i]));
+			BOOST_CHECK_EQUAL(name, std::get<1>(rows[i]));
+			BOOST_CHECK(price == std::get<2>(rows[i]));
+			++i;
+		}
+
+		BOOST_CHECK_EQUAL(i, rows.size());
+	}
+
+	{
+		// NULL in non-nullable column
+		auto query = m_sqliteDb->query<double>(L"select price from products where id = 2");
+		BOOST_CHECK_THROW(*query.begin(), SqliteInvalidTypeError);
+	}
+
+	m_sqliteDb->execute("drop table products");
+}
+
+BOOST_FIXTURE_TEST_CASE(testFixedStatement, SqliteDbFixture)
+{
+	BOOST_CHECK(STATIC_INIT_RESULTS == std::vector<long long>({ 1, 2 }));
+
+	static_assert(SqliteFixedString("select ? from t where a = ? and b = '?' -- ?").getParameterCount() == 2);
+	static_assert(SqliteFixedString("select ?2, ?1, ? /* ? */").getParameterCount() == 3);
+	static_assert(SqliteFixedString("select :a, @b, $c, :a from t where d = ':e' and f$g = 1").getParameterCount() == 3);
+	static_assert(SqliteFixedString("select ?, :a, ?1, :a, ?").getParameterCount() == 3);
+	static_assert(SqliteFixedString("select 1 ; \n").getSql() == "select 1");
+
+	using CreateProducts = SqliteStatement<"create table products ( id integer primary key, name text not null );">;
+	using InsertProduct = SqliteStatement<"insert into products (id, name) values (?, ?)", long long, std::string_view>;
+	using SelectProduct = SqliteStatement<"select name from products where id = ?", long long>;
+	using SelectProductByName = SqliteStatement<"select id from products where name = :name or name = upper(:name)", std::string_view>;
+	using DropProducts = SqliteStatement<"drop table products">;
+
+	CreateProducts::execute(*m_sqliteDb);
+
+	for (long long i = 0; i < 10; ++i)
+		InsertProduct::execute(*m_sqliteDb, i, "product " + std::to_string(i));
+
+	BOOST_CHECK_THROW(InsertProduct::execute(*m_sqliteDb, 1, "duplicate"), SqliteError);
+
+	for (long long i = 0; i < 10; ++i)
+	{
+		auto rs = SelectProduct::select(*m_sqliteDb, i);
+		BOOST_REQUIRE(rs);
+		BOOST_CHECK_EQUAL(rs.getString(0).value(), "product " + std::to_string(i));
+	}
+
+	BOOST_CHECK_EQUAL(SelectProductByName::select(*m_sqliteDb, "product 3").getInt64(0).value(), 3);
+
+	// Statements are not cached by the dynamic statement cache
+	BOOST_CHECK_EQUAL(m_sqliteDb->getStatementCacheStats().hits, 0);
+
+	DropProducts::execute(*m_sqliteDb);
+
+	// Statements are prepared again for another connection
+	m_sqliteDb = std::make_unique<SqliteDb>(m_tempFileName);
+
+	CreateProducts::execute(*m_sqliteDb);
+	InsertProduct::execute(*m_sqliteDb, 1, "bread");
+	BOOST_CHECK_EQUAL(SelectProduct::select(*m_sqliteDb, 1).getString(0).value(), "bread");
+	DropProducts::execute(*m_sqliteDb);
+}
+
+BOOST_FIXTURE_TEST_CASE(testScalarFunction, SqliteDbFixture)
+{
+	m_sqliteDb->createFunction("discount", [](double price, std::optional<double> rate) {
+		return price * (1 - rate.value_or(0));
+	}, true);
+
+	int calls = 0;
+	m_sqliteDb->createFunction("shout", [&calls](std::string_view text) {
+		++calls;
+
+		std::string res(text);
+		std::transform(res.begin(), res.end(), res.begin(), ::toupper);
+
+		return res;
+	});
+
+	m_sqliteDb->createFunction("fail", [](long long) -> long long {
+		throw std::runtime_error("failed");
+	});
+
+	// noexcept function object and function pointer
+	m_sqliteDb->createFunction("twice", [](long long value) noexcept {
+		return value * 2;
+	});
+
+	m_sqliteDb->createFunction("negate", +[](long long value) noexcept {
+		return -value;
+	});
+
+	BOOST_CHECK_EQUAL(m_sqliteDb->select("select discount(10, 0.25)").getDouble(0).value(), 7.5);
+	BOOST_CHECK_EQUAL(m_sqliteDb->select("select discount(10, null)").getDouble(0).value(), 10.0);
+	BOOST_CHECK_EQUAL(m_sqliteDb->select("select shout('bob')").getString(0).value(), "BOB");
+
+	// NULL passed to non-optional argument
+	BOOST_CHECK(m_sqliteDb->select("select shout(null)").isNull(0));
+	BOOST_CHECK_EQUAL(calls, 1);
+
+	// Deterministic function can be used in index
+	m_sqliteDb->execute("create table products ( id integer primary key, price real not null )");
+	m_sqliteDb->execute("create index ix_products_discount on products (discount(price, 0.1))");
+	BOOST_CHECK_THROW(m_sqliteDb->execute("create index ix_products_shout on products (shout(price))"), SqliteError);
+	m_sqliteDb->execute("drop table products");
+
+	// Wrong number of arguments
+	BOOST_CHECK_THROW(m_sqliteDb->select("select shout('a', 'b')"), SqliteError);
+
+	BOOST_CHECK_THROW(m_sqliteDb->select("select fail(1)"), SqliteError);
+
+	BOOST_CHECK_EQUAL(m_sqliteDb->select("select twice(21)").getInt64(0).value(), 42);
+	BOOST_CHECK_EQUAL(m_sqliteDb->select("select negate(twice(2))").getInt64(0).value(), -4);
+
+	// Numbers are converted between INTEGER and REAL, text is not a number
+	BOOST_CHECK_EQUAL(m_sqliteDb->select("select twice(2.6)").getInt64(0).value(), 4);
+	BOOST_CHECK_THROW(m_sqliteDb->select("select discount('10', 0.25)"), SqliteError);
+	BOOST_CHECK_THROW(m_sqliteDb->select("select twice('abc')"), SqliteError);
+}
+
+BOOST_FIXTURE_TEST_CASE(testAggregateFunction, SqliteDbFixture)
+{
+	m_sqliteDb->createAggregate<Median>("median");
+	m_sqliteDb->createAggregate<Average>("average");
+
+	m_sqliteDb->execute("create table samples ( id integer primary key, grp integer not null, value real null )");
+
+	auto insert = m_sqliteDb->preparePersistent("insert into samples (id, grp, value) values (?, ?, ?)");
+	for (int i = 1; i <= 9; ++i)
+		insert.addParameters(i, i % 2, i).execute();
+
+	insert.addParameters(10, 0, nullptr).execute();
+
+	{
+		auto rs = m_sqliteDb->select("select grp, median(value), average(value) from samples group by grp order by grp");
+
+		// 2, 4, 6, 8 and NULL
+		BOOST_REQUIRE(rs);
+		BOOST_CHECK_EQUAL(rs.getDouble(1).value(), 6.0);
+		BOOST_CHECK_EQUAL(rs.getDouble(2).value(), 5.0);
+
+		// 1, 3, 5, 7, 9
+		BOOST_REQUIRE(++rs);
+		BOOST_CHECK_EQUAL(rs.getDouble(1).value(), 5.0);
+		BOOST_CHECK_EQUAL(rs.getDouble(2).value(), 5.0);
+	}
+
+	// No rows
+	BOOST_CHECK(m_sqliteDb->select("select median(value) from samples where id < 0").isNull(0));
+
+	{
+		// Moving average over the current and two preceding rows
+		auto rs = m_sqliteDb->select("select average(value) over (order by id rows 2 preceding) from samples where id <= 5 order by id");
+
+		for (double expected : { 1.0, 1.5, 2.0, 3.0, 4.0 })
+		{
+			BOOST_REQUIRE(rs);
+			BOOST_CHECK_EQUAL(rs.getDouble(0).value(), expected);
+			++rs;
+		}
+
+		BOOST_CHECK(!rs);
+	}
+
+	// Aggregate without inverse() cannot be used with a sliding frame
+	BOOST_CHECK_THROW(m_sqliteDb->select("select median(value) over (order by id rows 2 preceding) from samples"), SqliteError);
+
+	m_sqliteDb->execute("drop table samples");
+}
+
+BOOST_FIXTURE_TEST_CASE(testVirtualTable, SqliteDbFixture)
+{
+	std::vector<Product> products;
+	for (long long id = 1; id <= 1000; ++id)
+		products.push_back(Product{ id * 2, "product " + std::to_string(id), id % 10 ? std::optional(id * 0.5) : std::nullopt });
+
+	m_sqliteDb->createVirtualTable("products", SqliteVirtualTable<Product>(products)
+		.addKeyColumn("id", &Product::id)
+		.addColumn("name", &Product::name)
+		.addColumn("price", &Product::price));
+
+	auto count = [this](std::string_view sql) {
+		return m_sqliteDb->select(sql).getInt64(0).value();
+	};
+
+	BOOST_CHECK_EQUAL(count("select count(*) from products"), 1000);
+	BOOST_CHECK_EQUAL(count("select count(*) from products where price is null"), 100);
+	BOOST_CHECK_EQUAL(count("select count(*) from products where id = 10"), 1);
+	BOOST_CHECK_EQUAL(count("select count(*) from products where id = 11"), 0);
+	BOOST_CHECK_EQUAL(count("select count(*) from products where id > 10 and id <= 20"), 5);
+	BOOST_CHECK_EQUAL(count("select count(*) from products where id >= 10 and id < 20"), 5);
+	BOOST_CHECK_EQUAL(count("select count(*) from products where id < 10.5"), 5);
+	BOOST_CHECK_EQUAL(count("select count(*) from products where id > 2000"), 0);
+	BOOST_CHECK_EQUAL(count("select count(*) from products where id = '10'"), 1);
+
+	BOOST_CHECK_EQUAL(m_sqliteDb->select("select name from products where id = 20").getString(0).value(), "product 10");
+
+	{
+		// Binary search is used for key constraints
+		auto rs = m_sqliteDb->select("explain query plan select * from products where id between 100 and 200");
+		BOOST_CHECK(rs.getString(3).value().find("INDEX 0:") == std::string::npos);
+	}
+
+	// Join
+	m_sqliteDb->execute("create table orders ( id integer primary key, product_id integer not null )");
+	m_sqliteDb->execute("insert into orders (id, product_id) values (1, 4), (2, 6), (3, 7)");
+
+	{
+		auto rs = m_sqliteDb->select("select o.id, p.name from orders o join products p on p.id = o.product_id order by o.id");
+		BOOST_REQUIRE(rs);
+		BOOST_CHECK_EQUAL(rs.getString(1).value(), "product 2");
+		BOOST_REQUIRE(++rs);
+		BOOST_CHECK_EQUAL(rs.getString(1).value(), "product 3");
+		BOOST_CHECK(!++rs);
+	}
+
+	m_sqliteDb->execute("drop table orders");
+
+	// Text key
+	std::vector<Product> productsByName(products.begin(), products.end());
+	std::sort(productsByName.begin(), productsByName.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.name < rhs.name;
+	});
+
+	m_sqliteDb->createVirtualTable("products_by_name", SqliteVirtualTable<Product>(productsByName)
+		.addColumn("id", &Product::id)
+		.addKeyColumn("name", &Product::name));
+
+	BOOST_CHECK_EQUAL(count("select id from products_by_name where name = 'product 7'"), 14);
+	BOOST_CHECK_EQUAL(count("select count(*) from products_by_name where name >= 'product 99'"), 11);
+	BOOST_CHECK_EQUAL(count("select count(*) from products_by_name where name = 'PRODUCT 7' collate nocase"), 1);
+
+	// Rows are sorted in BINARY collation only
+	const std::vector<Product> mixedCase{ Product{ 1, "B", std::nullopt }, Product{ 2, "C", std::nullopt }, Product{ 3, "a", std::nullopt } };
+	m_sqliteDb->createVirtualTable("mixed_case", SqliteVirtualTable<Product>(mixedCase)
+		.addKeyColumn("name", &Product::name));
+
+	{
+		auto rs = m_sqliteDb->select("select name from mixed_case order by name collate nocase");
+		BOOST_CHECK_EQUAL(rs.getString(0).value(), "a");
+		BOOST_CHECK_EQUAL((++rs).getString(0).value(), "B");
+		BOOST_CHECK_EQUAL((++rs).getString(0).value(), "C");
+	}
+
+	{
+		auto rs = m_sqliteDb->select("select name from mixed_case order by name");
+		BOOST_CHECK_EQUAL(rs.getString(0).value(), "B");
+		BOOST_CHECK_EQUAL((++rs).getString(0).value(), "C");
+		BOOST_CHECK_EQUAL((++rs).getString(0).value(), "a");
+	}
+}
+
+BOOST_FIXTURE_TEST_CASE(testBackup, SqliteDbFixture)
+{
+	m_sqliteDb->execute("create table products ( id integer primary key, name text not null )");
+
+	std::vector<std::tuple<int, std::string>> rows;
+	for (int i = 0; i < 2000; ++i)
+		rows.emplace_back(i, std::string(100, 'a' + i % 26));
+
+	m_sqliteDb->prepare("insert into products (id, name) values (?, ?)")
+		.executeBatch(rows);
+
+	const std::string backupFileName = std::tmpnam(nullptr);
+
+	int stepCount = 0;
+	int lastRemaining = -1;
+	m_sqliteDb->backupTo(backupFileName, 10, [&](int remaining, int total) {
+		BOOST_CHECK(remaining < total);
+		++stepCount;
+		lastRemaining = remaining;
+	});
+
+	BOOST_CHECK(stepCount > 1);
+	BOOST_CHECK_EQUAL(lastRemaining, 0);
+
+	{
+		// Restore into in-memory database
+		SqliteDb memoryDb(":memory:");
+		memoryDb.restoreFrom(backupFileName);
+
+		BOOST_CHECK_EQUAL(memoryDb.select("select count(*) from products").getInt(0).value(), 2000);
+
+		// Backup between connections
+		memoryDb.execute("delete from products where id >= 1000");
+		memoryDb.backupTo(*m_sqliteDb);
+	}
+
+	BOOST_CHECK_EQUAL(m_sqliteDb->select("select count(*) from products").getInt(0).value(), 1000);
+
+	std::remove(backupFileName.c_str());
+
+	m_sqliteDb->execute("drop table products");
+}
+
+BOOST_FIXTURE_TEST_CASE(testSerialize, SqliteDbFixture)
+{
+	m_sqliteDb->execute("create table products ( id integer primary key, name text not null )");
+	m_sqliteDb->execute("insert into products (id, name) values (1, 'bread'), (2, 'milk')");
+
+	const auto image = m_sqliteDb->serialize();
+	BOOST_REQUIRE(!image.empty());
+
+	{
+		// Copy of the image can be modified and grow
+		SqliteDb db(image);
+		BOOST_CHECK_EQUAL(db.select("select count(*) from products").getInt(0).value(), 2);
+
+		db.execute("create table dummy ( id integer primary key, name text not null )");
+		db.execute("insert into dummy (name) select name from products");
+
+		BOOST_CHECK(db.serialize().size() > image.size());
+	}
+
+	{
+		// Image used in place is read-only
+		SqliteDb db(image, false);
+		BOOST_CHECK_EQUAL(db.select("select name from products where id = 2").getString(0).value(), "milk");
+		BOOST_CHECK_THROW(db.execute("delete from products"), SqliteError);
+
+		BOOST_CHECK(db.serialize() == image);
+	}
+
+	// Empty image makes empty database
+	SqliteDb emptyDb(std::span<const std::byte>{});
+	BOOST_CHECK_EQUAL(emptyDb.select("select count(*) from sqlite_master").getInt(0).value(), 0);
+
+	m_sqliteDb->execute("drop table products");
+}
+
+BOOST_FIXTURE_TEST_CASE(testInterrupt, SqliteDbFixture)
+{
+	const std::string_view endlessSql = "with recursive numbers(n) as (select 1 union all select n + 1 from numbers) ";
+
+	// Deadline of execution
+	const auto start = std::chrono::steady_clock::now();
+	BOOST_CHECK_THROW(m_sqliteDb->prepare(std::string(endlessSql) + "select count(*) from numbers")
+		.withTimeout(std::chrono::milliseconds(50))
+		.select(), SqliteInterruptedError);
+	BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+
+	// Deadline covers recordset iteration
+	{
+		auto rs = m_sqliteDb->prepare(std::string(endlessSql) + "select n from numbers")
+			.withTimeout(std::chrono::milliseconds(50))
+			.select();
+
+		BOOST_CHECK_THROW(while (rs) ++rs, SqliteInterruptedError);
+		BOOST_CHECK(!rs);
+	}
+
+	// Interrupt from another thread; repeated in case it comes before the statement starts
+	std::atomic<bool> interrupted = false;
+	std::thread interrupter([this, &interrupted]() {
+		while (!interrupted)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			m_sqliteDb->interrupt();
+		}
+	});
+
+	BOOST_CHECK_THROW(m_sqliteDb->execute(std::string(endlessSql) + "select count(*) from numbers"), SqliteInterruptedError);
+	interrupted = true;
+	interrupter.join();
+
+	// Connection stays usable
+	BOOST_CHECK_EQUAL(m_sqliteDb->select("select 1").getInt(0).value(), 1);
+	BOOST_CHECK_EQUAL(m_sqliteDb->prepare("select 2").withTimeout(std::chrono::seconds(5)).select().getInt(0).value(), 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(testBusyPolicy, SqliteDbFixture)
+{
+	m_sqliteDb->execute("create table products ( id integer primary key, name text not null )");
+
+	SqliteDb otherDb(m_tempFileName);
+
+	// Write lock is held by the other connection
+	auto transaction = otherDb.beginTransaction();
+	otherDb.execute("insert into products (name) values ('bread')");
+
+	// Fails at once by default
+	BOOST_CHECK_THROW(m_sqliteDb->execute("insert into products (name) values ('milk')"), SqliteBusyError);
+	BOOST_CHECK_EQUAL(m_sqliteDb->getBusyStats().failureCount, 1);
+
+	// Batch transaction is started with the same busy handling
+	std::vector<std::string> names{ "salt", "sugar" };
+	BOOST_CHECK_THROW(m_sqliteDb->prepare("insert into products (name) values (?)").executeBatch(names), SqliteBusyError);
+	BOOST_CHECK_EQUAL(m_sqliteDb->getBusyStats().failureCount, 2);
+
+	// Waits for timeout
+	SqliteBusyPolicy policy;
+	policy.strategy = SqliteBusyPolicy::Strategy::Backoff;
+	policy.timeout = std::chrono::milliseconds(100);
+	m_sqliteDb->setBusyPolicy(policy);
+
+	const auto start = std::chrono::steady_clock::now();
+	BOOST_CHECK_THROW(m_sqliteDb->execute("insert into products (name) values ('milk')"), SqliteBusyError);
+	BOOST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(100));
+
+	auto stats = m_sqliteDb->getBusyStats();
+	BOOST_CHECK_EQUAL(stats.busyCount, 3);
+	BOOST_CHECK_EQUAL(stats.failureCount, 3);
+	BOOST_CHECK(stats.waitTime >= std::chrono::milliseconds(50));
+
+	// Lock is released while callback waits
+	policy.strategy = SqliteBusyPolicy::Strategy::Callback;
+	policy.callback = [&transaction](int attempt, std::chrono::milliseconds) {
+		if (2 == attempt)
+			transaction.commit();
+
+		return attempt < 10;
+	};
+	m_sqliteDb->setBusyPolicy(policy);
+
+	m_sqliteDb->execute("insert into products (name) values ('milk')");
+	BOOST_CHECK_EQUAL(m_sqliteDb->select("select count(*) from products").getInt(0).value(), 2);
+	BOOST_CHECK_EQUAL(m_sqliteDb->getBusyStats().failureCount, 3);
+
+	// Batch transaction waits for the lock as well
+	transaction = otherDb.beginTransaction();
+	otherDb.execute("insert into products (name) values ('butter')");
+
+	BOOST_CHECK_EQUAL(m_sqliteDb->prepare("insert into products (name) values (?)").executeBatch(names), 2);
+	BOOST_CHECK_EQUAL(m_sqliteDb->select("select count(*) from products").getInt(0).value(), 5);
+
+	// Callback is required
+	policy.callback = nullptr;
+	BOOST_CHECK_THROW(m_sqliteDb->setBusyPolicy(policy), SqliteError);
+
+	m_sqliteDb->execute("drop table products");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,5 +1,8 @@
 #include <string>
 #include <algorithm>
+#include <numeric>
+#include <cstdint>
+#include <ranges>
 #include <cstdio>
 #include <codecvt>
 #include "SqliteDb.h"
@@ -86,6 +89,27 @@ BOOST_FIXTURE_TEST_CASE(testBindWString, SqliteDbFixture)
 	BOOST_CHECK(val == L"aaa");
 }
 
+BOOST_FIXTURE_TEST_CASE(testBindString, SqliteDbFixture)
+{
+	const std::string val1{ "\xD0\xB0\xD0\xB1\xD0\xB2 abc" };
+
+	m_sqliteDb->prepare("insert into test (val_text) values (?)")
+		.addParameter(val1)
+		.execute();
+
+	std::string val2 = m_sqliteDb->select("select val_text from test").getString(0).value();
+	BOOST_CHECK(val1 == val2);
+
+	// Empty string must not be bound as NULL
+	m_sqliteDb->execute("delete from test");
+	m_sqliteDb->prepare("insert into test (val_text) values (?)")
+		.addParameter(std::string_view())
+		.execute();
+
+	auto val3 = m_sqliteDb->select("select val_text from test").getString(0);
+	BOOST_CHECK(val3.has_value() && val3->empty());
+}
+
 BOOST_FIXTURE_TEST_CASE(testBindBlob, SqliteDbFixture)
 {
 	std::string sz{ "abc" };
@@ -100,6 +124,35 @@ BOOST_FIXTURE_TEST_CASE(testBindBlob, SqliteDbFixture)
 	BOOST_CHECK(val1 == val2);
 }
 
+BOOST_FIXTURE_TEST_CASE(testTextAndBlobViews, SqliteDbFixture)
+{
+	std::vector<unsigned char> blob{ 1, 2, 3, 0, 5 };
+
+	m_sqliteDb->prepare("insert into test (val_text, val_blob) values (?, ?)")
+		.addParameter("abc")
+		.addParameterBlob(blob.data(), blob.size())
+		.execute();
+
+	m_sqliteDb->prepare("insert into test (val_text, val_blob) values (?, ?)")
+		.addParameterNull()
+		.addParameterBlob(blob.data(), 0)
+		.execute();
+
+	auto rs = m_sqliteDb->select("select val_text, val_blob from test order by rowid");
+
+	BOOST_CHECK(rs.getTextView(0).value() == "abc");
+
+	auto blobView = rs.getBlobView(1).value();
+	BOOST_CHECK(std::equal(blobView.begin(), blobView.end(), blob.begin(), blob.end(),
+		[](std::byte b, unsigned char ch) { return std::to_integer<unsigned char>(b) == ch; }));
+
+	BOOST_CHECK_THROW(rs.getBlobView(0), SqliteInvalidTypeError);
+
+	++rs;
+	BOOST_CHECK(!rs.getTextView(0).has_value());
+	BOOST_CHECK(rs.getBlobView(1).value().empty());
+}
+
 BOOST_FIXTURE_TEST_CASE(testBindDateTime, SqliteDbFixture)
 {
 	auto dt = std::chrono::utc_clock::now();
@@ -113,4 +166,189 @@ BOOST_FIXTURE_TEST_CASE(testBindDateTime, SqliteDbFixture)
 	BOOST_CHECK(eq);
 }
 
+BOOST_FIXTURE_TEST_CASE(testAddParameters, SqliteDbFixture)
+{
+	std::int64_t val1 = 1LL << 40;
+	std::optional<double> val2;
+	std::vector<unsigned char> val3{ 1, 2, 3 };
+
+	m_sqliteDb->prepare("insert into test (val_int, val_text, val_real, val_blob) values (?, ?, ?, ?)")
+		.addParameters(val1, "abc", val2, val3)
+		.execute();
+
+	auto rs = m_sqliteDb->select("select val_int, val_text, val_real, val_blob from test");
+	BOOST_CHECK_EQUAL(rs.getInt64(0).value(), val1);
+	BOOST_CHECK_EQUAL(rs.getString(1).value(), "abc");
+	BOOST_CHECK(rs.isNull(2));
+	BOOST_CHECK(rs.getBlob(3).value() == val3);
+}
+
+BOOST_FIXTURE_TEST_CASE(testExecuteBatch, SqliteDbFixture)
+{
+	std::vector<std::tuple<std::int64_t, std::string, std::optional<double>>> rows;
+	for (int i = 0; i < 1000; ++i)
+		rows.emplace_back(i, std::to_string(i), i % 2 ? std::optional<double>(i * 0.5) : std::nullopt);
+
+	auto rowCount = m_sqliteDb->prepare("insert into test (val_int, val_text, val_real) values (?, ?, ?)")
+		.executeBatch(rows);
+	BOOST_CHECK_EQUAL(rowCount, rows.size());
+
+	int nullCount = m_sqliteDb->select("select count(*) from test where val_real is null").getInt(0).value();
+	BOOST_CHECK_EQUAL(nullCount, 500);
+
+	// Single value rows
+	std::vector<int> values{ 2001, 2002, 2003 };
+	m_sqliteDb->prepare("insert into test (val_int) values (?)")
+		.executeBatch(values);
+
+	// Transaction begun while the batch runs is nested in the batch transaction
+	bool nested = false;
+	auto shiftedValues = values | std::views::transform([this, &nested](int value) {
+		nested = m_sqliteDb->beginTransaction().isNested();
+		return value + 1000;
+	});
+
+	m_sqliteDb->prepare("insert into test (val_int) values (?)")
+		.executeBatch(shiftedValues);
+	BOOST_CHECK(nested);
+	BOOST_CHECK(!m_sqliteDb->beginTransaction().isNested());
+
+	// Failed batch is rolled back as a whole
+	m_sqliteDb->execute("create unique index test_val_int on test (val_int)");
+
+	std::vector<std::pair<int, std::string>> duplicates{ { 5000, "a" }, { 5000, "b" } };
+	BOOST_CHECK_THROW(
+		m_sqliteDb->prepare("insert into test (val_int, val_text) values (?, ?)").executeBatch(duplicates),
+		SqliteError);
+
+	int count = m_sqliteDb->select("select count(*) from test").getInt(0).value();
+	BOOST_CHECK_EQUAL(count, 1006);
+}
+
+BOOST_FIXTURE_TEST_CASE(testBindArray, SqliteDbFixture)
+{
+	m_sqliteDb->execute("create table products ( id integer primary key, name text not null, price real not null )");
+
+	auto insert = m_sqliteDb->preparePersistent("insert into products (id, name, price) values (?, ?, ?)");
+	for (int i = 1; i <= 100; ++i)
+		insert.addParameters(i, "product " + std::to_string(i), i * 0.5).execute();
+
+	auto select = m_sqliteDb->preparePersistent("select count(*), sum(id) from products where id in yasw_array(?)");
+
+	const std::vector<long long> ids{ 3, 5, 7, 1000 };
+	{
+		auto rs = select.addParameterArray(ids).select();
+		BOOST_CHECK_EQUAL(rs.getInt(0).value(), 3);
+		BOOST_CHECK_EQUAL(rs.getInt(1).value(), 15);
+	}
+
+	// Same statement with array of another length
+	std::vector<long long> manyIds(1000);
+	std::iota(manyIds.begin(), manyIds.end(), 1);
+	{
+		auto rs = select.addParameterArray(manyIds).select();
+		BOOST_CHECK_EQUAL(rs.getInt(0).value(), 100);
+	}
+
+	{
+		auto rs = select.addParameterArray(std::span<const long long>()).select();
+		BOOST_CHECK_EQUAL(rs.getInt(0).value(), 0);
+	}
+
+	const std::vector<std::int64_t> int64Ids{ 2, 4 };
+	{
+		auto rs = select.addParameterArray(int64Ids).select();
+		BOOST_CHECK_EQUAL(rs.getInt(1).value(), 6);
+	}
+
+	const std::vector<int> intIds{ 10, 20, 30 };
+	{
+		auto rs = select.addParameterArray(intIds).select();
+		BOOST_CHECK_EQUAL(rs.getInt(1).value(), 60);
+	}
+
+	const std::vector<double> prices{ 0.5, 1.5, 2.25 };
+	BOOST_CHECK_EQUAL(m_sqliteDb->prepare("select count(*) from products where price in yasw_array(?)")
+		.addParameterArray(prices)
+		.select()
+		.getInt(0).value(), 2);
+
+	const std::vector<std::string> names{ "product 10", "product 20", "" };
+	BOOST_CHECK_EQUAL(m_sqliteDb->prepare("select sum(id) from products where name in yasw_array(?)")
+		.addParameterArray(names)
+		.select()
+		.getInt(0).value(), 30);
+
+	const std::vector<std::string_view> nameViews{ "product 1", "x" };
+	{
+		auto rs = m_sqliteDb->prepare("select value from yasw_array(?) order by rowid")
+			.addParameterArray(nameViews)
+			.select();
+
+		BOOST_CHECK_EQUAL(rs.getString(0).value(), "product 1");
+		BOOST_CHECK_EQUAL((++rs).getString(0).value(), "x");
+		BOOST_CHECK(!++rs);
+	}
+
+	m_sqliteDb->execute("drop table products");
+}
+
+BOOST_FIXTURE_TEST_CASE(testBlobStream, SqliteDbFixture)
+{
+	m_sqliteDb->execute("create table documents ( id integer primary key, content blob not null )");
+
+	const size_t size = 100000;
+	const size_t chunkSize = 4096;
+
+	for (long long id = 1; id <= 2; ++id)
+	{
+		m_sqliteDb->prepare("insert into documents (id, content) values (?, ?)")
+			.addParameter(id)
+			.addParameterZeroBlob(size)
+			.execute();
+	}
+
+	std::vector<std::byte> chunk(chunkSize);
+
+	{
+		auto blob = m_sqliteDb->openBlob("documents", "content", 1, true);
+		BOOST_CHECK_EQUAL(blob.getSize(), size);
+
+		for (long long id = 1; id <= 2; ++id)
+		{
+			if (id > 1)
+				blob.reopen(id);
+
+			for (size_t offset = 0; offset < size; offset += chunkSize)
+			{
+				const auto count = std::min(chunkSize, size - offset);
+				std::fill(chunk.begin(), chunk.end(), static_cast<std::byte>(offset / chunkSize + id));
+
+				blob.write(offset, std::span<const std::byte>(chunk.data(), count));
+			}
+		}
+
+		BOOST_CHECK_THROW(blob.write(size - 1, chunk), SqliteError);
+		BOOST_CHECK_THROW(blob.reopen(3), SqliteError);
+	}
+
+	{
+		auto blob = m_sqliteDb->openBlob("documents", "content", 2);
+
+		blob.read(chunkSize * 3, std::span<std::byte>(chunk.data(), 10));
+		BOOST_CHECK(std::byte{ 5 } == chunk[0] && std::byte{ 5 } == chunk[9]);
+
+		BOOST_CHECK_THROW(blob.write(0, std::span<const std::byte>(chunk.data(), 1)), SqliteError);
+	}
+
+	auto content = m_sqliteDb->select("select content from documents where id = 1").getBlob(0).value();
+	BOOST_REQUIRE_EQUAL(content.size(), size);
+	BOOST_CHECK_EQUAL(content[0], 1);
+	BOOST_CHECK_EQUAL(content[size - 1], (size - 1) / chunkSize + 1);
+
+	BOOST_CHECK_THROW(m_sqliteDb->openBlob("documents", "content", 3), SqliteError);
+
+	m_sqliteDb->execute("drop table documents");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,125 @@
+#include <string>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+#include "SqliteDbPool.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(testSuiteSqliteDbPool)
+
+namespace {
+
+	struct SqliteDbPoolFixture
+	{
+		SqliteDbPoolFixture()
+		{
+			m_tempFileName = std::tmpnam(nullptr);
+			m_pool = std::make_unique<SqliteDbPool>(m_tempFileName, 4);
+
+			m_pool->acquireWriter()->execute("create table products ( id integer primary key, name text not null )");
+		}
+
+		~SqliteDbPoolFixture()
+		{
+			m_pool.reset();
+
+			std::remove(m_tempFileName.c_str());
+			std::remove((m_tempFileName + "-wal").c_str());
+			std::remove((m_tempFileName + "-shm").c_str());
+		}
+
+		std::string m_tempFileName;
+		std::unique_ptr<SqliteDbPool> m_pool;
+	};
+
+} // namespace
+
+BOOST_FIXTURE_TEST_CASE(testReadersAreReadOnly, SqliteDbPoolFixture)
+{
+	BOOST_CHECK_EQUAL(m_pool->getReaderCount(), 4);
+
+	auto reader = m_pool->acquireReader();
+	BOOST_CHECK_THROW(reader->execute("insert into products (name) values ('bread')"), SqliteError);
+
+	auto journalMode = reader->select("PRAGMA journal_mode").getString(0).value();
+	BOOST_CHECK_EQUAL(journalMode, "wal");
+
+	// Pool without readers could not serve acquireReader()
+	BOOST_CHECK_THROW(SqliteDbPool(m_tempFileName, 0), SqliteError);
+}
+
+BOOST_FIXTURE_TEST_CASE(testLeaseReturnsConnection, SqliteDbPoolFixture)
+{
+	SqliteDb* db = nullptr;
+	{
+		auto writer = m_pool->acquireWriter();
+		db = &*writer;
+
+		auto writer2 = std::move(writer);
+		BOOST_CHECK(db == &*writer2);
+	}
+
+	// The only writer is available again
+	auto writer = m_pool->acquireWriter();
+	BOOST_CHECK(db == &*writer);
+}
+
+BOOST_FIXTURE_TEST_CASE(testConcurrentReadersAndWriter, SqliteDbPoolFixture)
+{
+	const int rowCount = 200;
+	std::atomic<bool> failed{ false };
+
+	std::thread writerThread([this, rowCount, &failed]() {
+		try
+		{
+			for (int i = 0; i < rowCount; ++i)
+			{
+				m_pool->acquireWriter()->prepare("insert into products (name) values (?)")
+					.addParameter(std::to_string(i))
+					.execute();
+			}
+		}
+		catch (...)
+		{
+			failed = true;
+		}
+	});
+
+	std::vector<std::thread> readerThreads;
+	for (int t = 0; t < 8; ++t)
+	{
+		readerThreads.emplace_back([this, &failed]() {
+			try
+			{
+				int lastCount = 0;
+				for (int i = 0; i < 50; ++i)
+				{
+					auto reader = m_pool->acquireReader();
+					int count = reader->select("select count(*) from products").getInt(0).value();
+
+					// Readers see a growing snapshot
+					if (count < lastCount)
+						failed = true;
+
+					lastCount = count;
+				}
+			}
+			catch (...)
+			{
+				failed = true;
+			}
+		});
+	}
+
+	writerThread.join();
+	for (auto& thread : readerThreads)
+		thread.join();
+
+	BOOST_CHECK(!failed);
+
+	int count = m_pool->acquireReader()->select("select count(*) from products").getInt(0).value();
+	BOOST_CHECK_EQUAL(count, rowCount);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
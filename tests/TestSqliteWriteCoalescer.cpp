@@ -0,0 +1,105 @@
+#include <string>
+#include <cstdio>
+#include <thread>
+#include "SqliteDb.h"
+#include "SqliteWriteCoalescer.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(testSuiteSqliteWriteCoalescer)
+
+namespace {
+
+	struct SqliteDbFixture
+	{
+		SqliteDbFixture()
+		{
+			m_tempFileName = std::tmpnam(nullptr);
+			m_sqliteDb = std::make_unique<SqliteDb>(m_tempFileName);
+
+			m_sqliteDb->execute("create table products ( id integer primary key, name text not null )");
+		}
+
+		~SqliteDbFixture()
+		{
+			m_sqliteDb.reset();
+			std::remove(m_tempFileName.c_str());
+		}
+
+		std::string m_tempFileName;
+		std::unique_ptr<SqliteDb> m_sqliteDb;
+	};
+
+	void insertProduct(SqliteDb& db, const std::string& name)
+	{
+		db.prepare("insert into products (name) values (?)")
+			.addParameter(name)
+			.execute();
+	}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_CASE(testWritesFromManyThreads, SqliteDbFixture)
+{
+	const int threadCount = 8;
+	const int writeCount = 100;
+
+	{
+		SqliteWriteCoalescer coalescer(*m_sqliteDb, 64);
+
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threadCount; ++t)
+		{
+			threads.emplace_back([&coalescer, t, writeCount]() {
+				std::vector<std::future<void>> futures;
+				for (int i = 0; i < writeCount; ++i)
+				{
+					futures.push_back(coalescer.submit([t, i](SqliteDb& db) {
+						insertProduct(db, std::to_string(t) + "-" + std::to_string(i));
+					}));
+				}
+
+				for (auto& future : futures)
+					future.get();
+			});
+		}
+
+		for (auto& thread : threads)
+			thread.join();
+	}
+
+	int count = m_sqliteDb->select("select count(*) from products").getInt(0).value();
+	BOOST_CHECK_EQUAL(count, threadCount * writeCount);
+}
+
+BOOST_FIXTURE_TEST_CASE(testFailedWriteIsRolledBackAlone, SqliteDbFixture)
+{
+	{
+		SqliteWriteCoalescer coalescer(*m_sqliteDb, 16, std::chrono::milliseconds(50));
+
+		auto ok1 = coalescer.submit([](SqliteDb& db) {
+			insertProduct(db, "bread");
+		});
+
+		auto failed = coalescer.submit([](SqliteDb& db) {
+			insertProduct(db, "butter");
+			throw std::runtime_error("write failed");
+		});
+
+		auto ok2 = coalescer.submit([](SqliteDb& db) {
+			insertProduct(db, "milk");
+		});
+
+		BOOST_CHECK_NO_THROW(ok1.get());
+		BOOST_CHECK_THROW(failed.get(), std::runtime_error);
+		BOOST_CHECK_NO_THROW(ok2.get());
+	}
+
+	int count = m_sqliteDb->select("select count(*) from products").getInt(0).value();
+	BOOST_CHECK_EQUAL(count, 2);
+
+	int butterCount = m_sqliteDb->select("select count(*) from products where name = 'butter'").getInt(0).value();
+	BOOST_CHECK_EQUAL(butterCount, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -15,14 +15,41 @@ SOURCES += \
     src/SqliteDb.cpp \
     src/SqliteRecordset.cpp \
     src/SqliteCommand.cpp \
-    src/SqliteTransaction.cpp
+    src/SqliteTransaction.cpp \
+    src/SqliteStatementCache.cpp \
+    src/SqliteBusyHandler.cpp \
+    src/SqliteColumnBatch.cpp \
+    src/SqliteDbPool.cpp \
+    src/SqliteWriteCoalescer.cpp \
+    src/SqliteProfiler.cpp \
+    src/SqliteFunction.cpp \
+    src/SqliteArray.cpp \
+    src/SqliteVirtualTable.cpp \
+    src/SqliteBlobStream.cpp \
+    src/SqliteAsyncDb.cpp
 
 HEADERS += \
     amalgamation/sqlite3.h \
     include/yasw/SqliteDb.h \
+    include/yasw/SqliteDbOptions.h \
     include/yasw/SqliteRecordset.h \
     include/yasw/SqliteCommand.h \
     include/yasw/SqliteTransaction.h \
+    include/yasw/SqliteStatementCache.h \
+    include/yasw/SqliteBusyPolicy.h \
+    include/yasw/SqliteBusyHandler.h \
+    include/yasw/SqliteColumnBatch.h \
+    include/yasw/SqliteDbPool.h \
+    include/yasw/SqliteWriteCoalescer.h \
+    include/yasw/SqliteProfiler.h \
+    include/yasw/SqliteQuery.h \
+    include/yasw/SqliteFixedString.h \
+    include/yasw/SqliteStatement.h \
+    include/yasw/SqliteFunction.h \
+    include/yasw/SqliteArray.h \
+    include/yasw/SqliteVirtualTable.h \
+    include/yasw/SqliteBlobStream.h \
+    include/yasw/SqliteAsyncDb.h \
     include/yasw/SqliteExceptions.h
 
 INCLUDEPATH += amalgamation